@@ -0,0 +1,102 @@
+"""Drives rickshell on a pseudo-terminal for the interactive benchmarks."""
+import os
+import pty
+import select
+import signal
+import statistics
+import time
+
+ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+PROMPT = b"$ "
+
+
+def binary():
+    return os.environ.get("RICKSHELL", os.path.join(ROOT, "rickshell"))
+
+
+class Shell:
+    """One interactive rickshell with HOME and the working directory set to
+    `home`. `spawned` is the perf_counter() time just before the fork."""
+
+    def __init__(self, home, env=None, args=()):
+        full_env = {"HOME": home, "PATH": "/usr/bin:/bin", "TERM": "xterm"}
+        full_env.update(env or {})
+        self.spawned = time.perf_counter()
+        self.pid, self.fd = pty.fork()
+        if self.pid == 0:
+            os.chdir(home)
+            os.execve(binary(), ["rickshell", *args], full_env)
+        self.output = b""
+
+    def read_until(self, token, timeout=10.0):
+        """Reads until `token` shows up in the output received since the last
+        call and returns perf_counter() at that point, or None on timeout."""
+        end = time.perf_counter() + timeout
+        seen = b""
+        while token not in seen:
+            left = end - time.perf_counter()
+            if left <= 0:
+                return None
+            ready, _, _ = select.select([self.fd], [], [], left)
+            if not ready:
+                return None
+            try:
+                chunk = os.read(self.fd, 65536)
+            except OSError:
+                return None
+            seen += chunk
+        self.output = seen
+        return time.perf_counter()
+
+    def drain(self, seconds):
+        """Reads for `seconds` and returns what arrived."""
+        end = time.perf_counter() + seconds
+        out = b""
+        while True:
+            left = end - time.perf_counter()
+            if left <= 0:
+                return out
+            ready, _, _ = select.select([self.fd], [], [], left)
+            if ready:
+                try:
+                    out += os.read(self.fd, 65536)
+                except OSError:
+                    return out
+
+    def send(self, data):
+        os.write(self.fd, data)
+
+    def rss_kb(self, field="VmRSS"):
+        """`field` is a /proc/PID/status memory line such as RssAnon."""
+        with open("/proc/%d/status" % self.pid) as status:
+            for line in status:
+                if line.startswith(field + ":"):
+                    return int(line.split()[1])
+        return 0
+
+    def exit(self):
+        self.send(b"exit\r")
+        self.drain(0.3)
+        self._reap()
+
+    def kill(self):
+        """Stops the shell without running its exit path, so it cannot
+        rewrite the history file or caches a benchmark depends on."""
+        os.kill(self.pid, signal.SIGKILL)
+        self._reap()
+
+    def _reap(self):
+        try:
+            os.close(self.fd)
+        except OSError:
+            pass
+        os.waitpid(self.pid, 0)
+
+
+def summary(samples_ms):
+    ordered = sorted(samples_ms)
+    return "median %7.2f ms  p10 %7.2f  p90 %7.2f" % (
+        statistics.median(ordered),
+        ordered[len(ordered) // 10],
+        ordered[len(ordered) * 9 // 10],
+    )
@@ -0,0 +1,86 @@
+#!/usr/bin/env python3
+"""Ctrl-R latency over a large history: the time from each key of the query
+to the redrawn search row. The first Ctrl-R of a session builds the trigram
+index and is reported on its own.
+
+Usage: bench/ctrl_r.py [--entries N] [--rounds N]
+"""
+import argparse
+import os
+import random
+import shutil
+import statistics
+import tempfile
+
+import benchpty
+
+WORDS = ("git commit push status make build install docker run kubectl get pods "
+         "ssh deploy grep find xargs python3 manage migrate cargo test npm tail "
+         "journalctl systemctl restart nginx postgres redis curl jq awk sed").split()
+QUERIES = ["dock", "kubectl get", "nginx", "cargo test 4", "zzzz", "ssh deploy-17", "status"]
+
+
+def write_history(home, entries):
+    rng = random.Random(42)
+    os.makedirs(os.path.join(home, ".rickshell"), exist_ok=True)
+    with open(os.path.join(home, ".rickshell", ".history"), "w") as history:
+        for i in range(entries):
+            words = rng.sample(WORDS, rng.randint(2, 6))
+            history.write("#%d;bench\n%s %s-%d\n" % (1700000000 + i, " ".join(words), rng.choice(WORDS), i % 5000))
+
+
+def type_query(shell, query, latencies):
+    for n in range(1, len(query) + 1):
+        sent = benchpty.time.perf_counter()
+        shell.send(query[n - 1].encode())
+        shown = shell.read_until(("`%s'" % query[:n]).encode())
+        if shown is None:
+            raise SystemExit("search row for %r never appeared" % query[:n])
+        latencies.append((shown - sent) * 1000)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--entries", type=int, default=1000000)
+    parser.add_argument("--rounds", type=int, default=5)
+    args = parser.parse_args()
+
+    home = tempfile.mkdtemp(prefix="rickshell-ctrlr-")
+    try:
+        write_history(home, args.entries)
+        shell = benchpty.Shell(home, env={"HISTSIZE": str(args.entries)})
+        if shell.read_until(benchpty.PROMPT) is None:
+            raise SystemExit("no prompt")
+        shell.drain(1.0)
+
+        sent = benchpty.time.perf_counter()
+        shell.send(b"\x12")
+        first = shell.read_until(b"reverse-i-search")
+        type_query(shell, QUERIES[0], [])
+        built = (benchpty.time.perf_counter() - sent) * 1000
+        shell.send(b"\x07")
+        shell.drain(0.2)
+        if first is None:
+            raise SystemExit("Ctrl-R did not open a search")
+
+        latencies = []
+        for _ in range(args.rounds):
+            for query in QUERIES:
+                shell.send(b"\x12")
+                shell.read_until(b"reverse-i-search")
+                type_query(shell, query, latencies)
+                shell.send(b"\x07")
+                shell.drain(0.05)
+        shell.kill()
+
+        print("%d entries" % args.entries)
+        print("  first search, index build included  %8.2f ms" % built)
+        print("  per key  %s  max %.2f ms  (%d keys)" %
+              (benchpty.summary(latencies), max(latencies), len(latencies)))
+        print("  mean %.3f ms" % statistics.mean(latencies))
+    finally:
+        shutil.rmtree(home)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,33 @@
+#!/bin/sh
+# echo throughput: many short `echo -e` calls, then one call with a large
+# escaped argument, all written to /dev/null. bash runs the same scripts
+# for comparison.
+#
+# Usage: bench/echo.sh   (ECHO_LINES, ECHO_BIG_KB, BENCH_RUNS, RICKSHELL)
+set -eu
+. "$(dirname "$0")/lib.sh"
+
+LINES=${ECHO_LINES:-20000}
+BIG_KB=${ECHO_BIG_KB:-1024}
+CHUNK='plain text\tand a tab\nnew line \\ backslash \x41\x42 \0101 '
+
+awk -v n="$LINES" -v s="$CHUNK" 'BEGIN { for (i = 0; i < n; i++) printf "echo -e \"%s%d\"\n", s, i }' \
+  > "$BENCH_WORK/small.sh"
+awk -v n="$((BIG_KB * 1024 / ${#CHUNK}))" -v s="$CHUNK" \
+  'BEGIN { printf "echo -e \""; for (i = 0; i < n; i++) printf "%s", s; printf "\"\n" }' \
+  > "$BENCH_WORK/big.sh"
+
+report() {
+  name=$1
+  script=$2
+  bytes=$("$RICKSHELL" "$script" | wc -c)
+  for shell in "$RICKSHELL" bash; do
+    command -v "$shell" >/dev/null 2>&1 || continue
+    us=$(best_us "$shell" "$script")
+    printf '%-10s %-10s %10s ms %8s MB/s\n' "$name" "$(basename "$shell")" "$(ms "$us")" \
+      "$(awk -v b="$bytes" -v us="$us" 'BEGIN { printf "%.1f", (us > 0 ? b / us : 0) }')"
+  done
+}
+
+report "${LINES}x" "$BENCH_WORK/small.sh"
+report "${BIG_KB}KB" "$BENCH_WORK/big.sh"
@@ -0,0 +1,53 @@
+#!/usr/bin/env python3
+"""Time to first prompt and resident memory with history files of 1k to 1M
+entries. Startup only maps the history file and hands readline the newest
+HISTSIZE entries, so the time should stay flat as the file grows. RSS
+includes the mapped file pages touched and the suggestion index the
+background worker builds; anon leaves out the mapped file.
+
+Usage: bench/history_startup.py [sizes...] [--runs N]
+"""
+import argparse
+import os
+import shutil
+import tempfile
+
+import benchpty
+
+
+def write_history(home, entries):
+    os.makedirs(os.path.join(home, ".rickshell"), exist_ok=True)
+    with open(os.path.join(home, ".rickshell", ".history"), "w") as history:
+        for i in range(entries):
+            history.write("#%d;bench\n" % (1700000000 + i))
+            history.write("git commit -m 'change %d' && make build %d\n" % (i, i % 97))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("sizes", nargs="*", type=int, default=[1000, 10000, 100000, 1000000])
+    parser.add_argument("--runs", type=int, default=20)
+    args = parser.parse_args()
+
+    for entries in args.sizes:
+        home = tempfile.mkdtemp(prefix="rickshell-hist-")
+        try:
+            write_history(home, entries)
+            samples, rss, anon = [], 0, 0
+            for _ in range(args.runs):
+                shell = benchpty.Shell(home)
+                shown = shell.read_until(benchpty.PROMPT)
+                if shown is None:
+                    raise SystemExit("no prompt with %d history entries" % entries)
+                samples.append((shown - shell.spawned) * 1000)
+                rss = max(rss, shell.rss_kb())
+                anon = max(anon, shell.rss_kb("RssAnon"))
+                shell.kill()
+            print("%8d entries  %s  rss %5.1f MB (anon %5.1f)" %
+                  (entries, benchpty.summary(samples), rss / 1024, anon / 1024))
+        finally:
+            shutil.rmtree(home)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,35 @@
+# Helpers shared by the benchmark scripts; source it from bench/*.sh.
+# RICKSHELL overrides the binary under test, BENCH_RUNS the repetitions.
+
+BENCH_ROOT=$(cd "$(dirname "$0")/.." && pwd)
+RICKSHELL=${RICKSHELL:-$BENCH_ROOT/rickshell}
+BENCH_RUNS=${BENCH_RUNS:-10}
+
+if [ ! -x "$RICKSHELL" ]; then
+  echo "bench: $RICKSHELL not found; run make build first or set RICKSHELL" >&2
+  exit 1
+fi
+
+BENCH_WORK=$(mktemp -d)
+trap 'rm -rf "$BENCH_WORK"' EXIT INT TERM
+
+# best_us <command...>: fastest wall time of BENCH_RUNS runs in microseconds,
+# with stdin from /dev/null and output discarded.
+best_us() {
+  best=
+  run=0
+  while [ $run -lt "$BENCH_RUNS" ]; do
+    start=$(date +%s%N)
+    "$@" </dev/null >/dev/null 2>&1
+    end=$(date +%s%N)
+    took=$(((end - start) / 1000))
+    if [ -z "$best" ] || [ $took -lt $best ]; then best=$took; fi
+    run=$((run + 1))
+  done
+  echo $best
+}
+
+# ms <microseconds>
+ms() {
+  printf '%d.%03d' $(($1 / 1000)) $(($1 % 1000))
+}
@@ -0,0 +1,88 @@
+#!/usr/bin/env python3
+"""Cold-cache command latency with and without RICKSHELL_PREFETCH. Before
+each trial the command's binary is evicted from the page cache; the command
+is then typed at a fixed speed, the shell is left idle for the think time,
+and Enter-to-next-prompt is timed. A warm-cache run gives the floor.
+
+Usage: bench/prefetch.py [--command "python3 -c 0"] [--think 0,300,1000]
+                         [--trials N] [--evict FILE...]
+"""
+import argparse
+import os
+import shlex
+import shutil
+import statistics
+import tempfile
+
+import benchpty
+
+KEY_DELAY = 0.08
+
+
+def evict(paths):
+    for path in paths:
+        fd = os.open(path, os.O_RDONLY)
+        try:
+            os.posix_fadvise(fd, 0, 0, os.POSIX_FADV_DONTNEED)
+        finally:
+            os.close(fd)
+
+
+def run(home, command, think, trials, prefetch, paths):
+    """A fresh shell per trial: the prefetcher skips files it warmed a moment
+    ago, so a second trial in the same session would measure nothing."""
+    env = {"RICKSHELL_PREFETCH": "1" if prefetch else "0"}
+    samples = []
+    for _ in range(trials):
+        shell = benchpty.Shell(home, env=env)
+        if shell.read_until(benchpty.PROMPT) is None:
+            raise SystemExit("no prompt")
+        shell.drain(0.5)
+        if paths:
+            evict(paths)
+        for key in command:
+            shell.send(key.encode())
+            shell.drain(KEY_DELAY)
+        shell.drain(think / 1000)
+        sent = benchpty.time.perf_counter()
+        shell.send(b"\r")
+        done = shell.read_until(benchpty.PROMPT, timeout=30)
+        if done is None:
+            raise SystemExit("%r did not finish" % command)
+        samples.append((done - sent) * 1000)
+        shell.exit()
+    return statistics.median(samples)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--command", default="python3 -c 0")
+    parser.add_argument("--think", default="0,300,1000")
+    parser.add_argument("--trials", type=int, default=5)
+    parser.add_argument("--evict", nargs="*", default=None,
+                        help="files to drop from the cache (default: the command's binary)")
+    args = parser.parse_args()
+
+    paths = args.evict
+    if paths is None:
+        found = shutil.which(shlex.split(args.command)[0], path="/usr/bin:/bin")
+        if found is None:
+            raise SystemExit("%s not found" % args.command)
+        paths = [os.path.realpath(found)]
+
+    home = tempfile.mkdtemp(prefix="rickshell-prefetch-")
+    try:
+        warm = run(home, args.command, 0, args.trials, False, [])
+        print("%r, evicting %s" % (args.command, " ".join(paths)))
+        print("  warm cache        %7.1f ms" % warm)
+        print("  think     off     prefetch")
+        for think in (int(t) for t in args.think.split(",")):
+            off = run(home, args.command, think, args.trials, False, paths)
+            on = run(home, args.command, think, args.trials, True, paths)
+            print("  %5dms  %7.1f ms  %7.1f ms" % (think, off, on))
+    finally:
+        shutil.rmtree(home)
+
+
+if __name__ == "__main__":
+    main()
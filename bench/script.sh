@@ -0,0 +1,47 @@
+#!/bin/sh
+# Script mode: a generated script of builtins (echo, assignments, `;`,
+# comments, backslash continuations, quoted strings) run by rickshell, bash
+# and dash, from a file and from a pipe. rickshell's output must match
+# bash's byte for byte.
+#
+# Usage: bench/script.sh   (SCRIPT_STATEMENTS, BENCH_RUNS, RICKSHELL)
+set -eu
+. "$(dirname "$0")/lib.sh"
+
+STATEMENTS=${SCRIPT_STATEMENTS:-10000}
+SCRIPT="$BENCH_WORK/script.sh"
+
+awk -v n="$STATEMENTS" 'BEGIN {
+  for (i = 0; i < n; i++) {
+    k = i % 5
+    if (k == 0) printf "echo line %d \"quoted %d\"\n", i, i
+    else if (k == 1) printf "V%d=value%d\n", i % 50, i
+    else if (k == 2) printf "echo $V%d # comment %d\n", (i - 1) % 50, i
+    else if (k == 3) printf "echo a%d; echo b%d\n", i, i
+    else printf "echo cont%d \\\n  tail%d\n", i, i
+  }
+}' > "$SCRIPT"
+
+from_pipe() {
+  cat "$SCRIPT" | "$1"
+}
+
+if command -v bash >/dev/null 2>&1; then
+  bash "$SCRIPT" > "$BENCH_WORK/bash.out"
+  "$RICKSHELL" "$SCRIPT" > "$BENCH_WORK/file.out"
+  from_pipe "$RICKSHELL" > "$BENCH_WORK/pipe.out"
+  if cmp -s "$BENCH_WORK/file.out" "$BENCH_WORK/bash.out" && cmp -s "$BENCH_WORK/pipe.out" "$BENCH_WORK/bash.out"; then
+    echo "output matches bash ($(wc -l < "$SCRIPT") lines)"
+  else
+    echo "output differs from bash" >&2
+    exit 1
+  fi
+fi
+
+printf '%-10s %12s %12s\n' shell file pipe
+for shell in "$RICKSHELL" bash dash; do
+  command -v "$shell" >/dev/null 2>&1 || continue
+  file_us=$(best_us "$shell" "$SCRIPT")
+  pipe_us=$(best_us from_pipe "$shell")
+  printf '%-10s %9s ms %9s ms\n' "$(basename "$shell")" "$(ms "$file_us")" "$(ms "$pipe_us")"
+done
@@ -0,0 +1,67 @@
+#!/usr/bin/env python3
+"""Time to first prompt: spawn until the prompt is drawn on a pty, once with
+the PATH cache in place and once with it removed before every run (first
+start, or a new PATH). With --max-ms it exits non-zero when the warm median
+is over budget, so CI can gate on it.
+
+Usage: bench/startup.py [--runs N] [--path DIRS] [--max-ms MS] [--profile]
+"""
+import argparse
+import os
+import shutil
+import statistics
+import sys
+import tempfile
+
+import benchpty
+
+
+def first_prompt_ms(home, path, fresh_cache, args=()):
+    if fresh_cache:
+        try:
+            os.unlink(os.path.join(home, ".rickshell", "pathcache"))
+        except FileNotFoundError:
+            pass
+    shell = benchpty.Shell(home, env={"PATH": path}, args=args)
+    shown = shell.read_until(benchpty.PROMPT)
+    if shown is None:
+        raise SystemExit("no prompt")
+    shell.drain(0.1)
+    shell.exit()
+    return (shown - shell.spawned) * 1000
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--runs", type=int, default=40)
+    parser.add_argument("--path", default=os.environ.get("PATH", "/usr/bin:/bin"))
+    parser.add_argument("--max-ms", type=float, default=None)
+    parser.add_argument("--profile", action="store_true", help="also print one --startup-profile table")
+    args = parser.parse_args()
+
+    home = tempfile.mkdtemp(prefix="rickshell-startup-")
+    try:
+        first_prompt_ms(home, args.path, False)
+        warm = [first_prompt_ms(home, args.path, False) for _ in range(args.runs)]
+        cold = [first_prompt_ms(home, args.path, True) for _ in range(args.runs)]
+        print("warm path cache  %s" % benchpty.summary(warm))
+        print("no path cache    %s" % benchpty.summary(cold))
+
+        if args.profile:
+            shell = benchpty.Shell(home, env={"PATH": args.path}, args=["--startup-profile"])
+            shell.read_until(benchpty.PROMPT)
+            shell.drain(0.1)
+            shell.send(b"exit\r")
+            text = shell.drain(0.5).decode(errors="replace").replace("\r", "")
+            print(text[text.find("startup profile:"):].rstrip())
+            shell.kill()
+
+        if args.max_ms is not None and statistics.median(warm) > args.max_ms:
+            print("median %.2f ms is over the %.2f ms budget" % (statistics.median(warm), args.max_ms))
+            sys.exit(1)
+    finally:
+        shutil.rmtree(home)
+
+
+if __name__ == "__main__":
+    main()
@@ -10,6 +10,7 @@ static builtin_command builtin_commands[] = {
   {_SLIT("echo"), builtin_echo},
   {_SLIT("exit"), builtin_exit},
   {_SLIT("export"), builtin_export},
+  {_SLIT("fuzzy"), builtin_fuzzy},
   {_SLIT("help"), builtin_help},
   {_SLIT("history"), builtin_history},
   {_SLIT("printf"), builtin_printf},
@@ -35,4 +36,8 @@ builtin_func get_builtin_func(const string name) {
     }
   }
   return NULL;
+}
+
+string get_builtin_name(size_t index) {
+  return index < BUILTIN_FUNCS_SIZE ? builtin_commands[index].name : _SLIT0;
 }
\ No newline at end of file
@@ -0,0 +1,448 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <strings.h>
+#include <dirent.h>
+#include <poll.h>
+#include <time.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include <readline/readline.h>
+#include "complete.h"
+#include "dircache.h"
+#include "pathindex.h"
+#include "builtin.h"
+#include "prompt.h"
+#include "memory.h"
+#include "loop.h"
+
+typedef struct {
+  char** items;
+  size_t len;
+  size_t capacity;
+} CompleteMatches;
+
+typedef struct {
+  char* dir;
+  char* text;
+  size_t dir_len;
+  bool fold;
+  bool dirs_only;
+} CompleteJob;
+
+/* Filename matches are produced by a worker so that a slow directory never
+ * holds up typing. `generation` moves on whenever the job being waited for
+ * changes or is abandoned; the worker checks it between entries and drops
+ * whatever it was doing. `results` always belongs to the current generation. */
+static struct {
+  pthread_t worker;
+  bool worker_started;
+  pthread_mutex_t lock;
+  pthread_cond_t wake;
+  int event_fd;
+  CompleteJob* request;
+  CompleteJob* current;
+  atomic_ulong generation;
+  bool done;
+  bool stop;
+  CompleteMatches results;
+} comp = {.lock = PTHREAD_MUTEX_INITIALIZER, .wake = PTHREAD_COND_INITIALIZER, .event_fd = -1};
+
+static CompleteMatches matches;
+static size_t next_index;
+/* The line a partial list was shown for; the full list follows if it is
+ * still unchanged when the worker finishes. */
+static struct {
+  char* line;
+  int point;
+} partial;
+
+static void matches_add(CompleteMatches* m, const char* dir, size_t dir_len, const char* name, size_t len) {
+  if (m->len == m->capacity) {
+    m->capacity = m->capacity ? m->capacity * 2 : 64;
+    m->items = rrealloc(m->items, m->capacity * sizeof(char*));
+  }
+  char* match = rmalloc(dir_len + len + 1);
+  memcpy(match, dir, dir_len);
+  memcpy(match + dir_len, name, len);
+  match[dir_len + len] = '\0';
+  m->items[m->len++] = match;
+}
+
+static void matches_clear(CompleteMatches* m) {
+  for (size_t i = 0; i < m->len; i++) rfree(m->items[i]);
+  m->len = 0;
+}
+
+static void job_free(CompleteJob* job) {
+  if (job == NULL) return;
+  rfree(job->dir);
+  rfree(job->text);
+  rfree(job);
+}
+
+static CompleteJob* job_clone(const CompleteJob* job) {
+  CompleteJob* copy = rmalloc(sizeof(CompleteJob));
+  *copy = *job;
+  copy->dir = rstrdup(job->dir);
+  copy->text = rstrdup(job->text);
+  return copy;
+}
+
+static bool job_equals(const CompleteJob* a, const CompleteJob* b) {
+  return a != NULL && b != NULL && a->fold == b->fold && a->dirs_only == b->dirs_only &&
+         strcmp(a->dir, b->dir) == 0 && strcmp(a->text, b->text) == 0;
+}
+
+typedef struct {
+  const CompleteJob* job;
+  unsigned long generation;
+} CompleteScan;
+
+static bool job_wants(const CompleteJob* job, const char* name, size_t len) {
+  const char* base = job->text + job->dir_len;
+  size_t base_len = strlen(base);
+  if (name[0] == '.' && base[0] != '.') return false;
+  if (len < base_len) return false;
+  return job->fold ? strncasecmp(name, base, base_len) == 0 : strncmp(name, base, base_len) == 0;
+}
+
+/* Streams matches out of a directory that is being read for the first time. */
+static bool stream_entry(const char* name, size_t len, unsigned char type, void* ctx) {
+  const CompleteScan* scan = ctx;
+  if (atomic_load(&comp.generation) != scan->generation) return false;
+  if (!job_wants(scan->job, name, len)) return true;
+  if (scan->job->dirs_only && type != DT_DIR) return true;
+  pthread_mutex_lock(&comp.lock);
+  if (atomic_load(&comp.generation) == scan->generation) {
+    matches_add(&comp.results, scan->job->text, scan->job->dir_len, name, len);
+    loop_event_signal(comp.event_fd);
+  }
+  pthread_mutex_unlock(&comp.lock);
+  return true;
+}
+
+static void run_job(const CompleteJob* job, unsigned long generation) {
+  CompleteScan scan = {.job = job, .generation = generation};
+  const DirListing* listing = dir_cache_get(job->dir, job->fold, stream_entry, &scan);
+
+  CompleteMatches found = {0};
+  if (listing != NULL) {
+    const char* base = job->text + job->dir_len;
+    size_t first;
+    size_t count = dir_listing_find_prefix(listing, base, strlen(base), job->fold, &first);
+    for (size_t i = 0; i < count && atomic_load(&comp.generation) == generation; i++) {
+      const DirEntry* entry = dir_listing_at(listing, first + i, job->fold);
+      if (!job_wants(job, entry->name, entry->len)) continue;
+      if (job->dirs_only && dir_entry_type(listing, entry) != DT_DIR) continue;
+      matches_add(&found, job->text, job->dir_len, entry->name, entry->len);
+    }
+  }
+
+  pthread_mutex_lock(&comp.lock);
+  if (atomic_load(&comp.generation) == generation) {
+    matches_clear(&comp.results);
+    rfree(comp.results.items);
+    comp.results = found;
+    found = (CompleteMatches){0};
+    comp.done = true;
+    loop_event_signal(comp.event_fd);
+  }
+  pthread_mutex_unlock(&comp.lock);
+  matches_clear(&found);
+  rfree(found.items);
+}
+
+static void* complete_worker(void* arg) {
+  (void)arg;
+  pthread_mutex_lock(&comp.lock);
+  for (;;) {
+    while (comp.request == NULL && !comp.stop)
+      pthread_cond_wait(&comp.wake, &comp.lock);
+    if (comp.stop) break;
+    CompleteJob* job = comp.request;
+    comp.request = NULL;
+    unsigned long generation = atomic_load(&comp.generation);
+    pthread_mutex_unlock(&comp.lock);
+
+    run_job(job, generation);
+    job_free(job);
+
+    pthread_mutex_lock(&comp.lock);
+  }
+  pthread_mutex_unlock(&comp.lock);
+  return NULL;
+}
+
+/* Must be called with comp.lock held. */
+static void cancel_job(void) {
+  atomic_fetch_add(&comp.generation, 1);
+  job_free(comp.request);
+  comp.request = NULL;
+  job_free(comp.current);
+  comp.current = NULL;
+  matches_clear(&comp.results);
+  comp.done = false;
+}
+
+static bool submit_job(const CompleteJob* job) {
+  pthread_mutex_lock(&comp.lock);
+  if (comp.event_fd == -1) comp.event_fd = loop_event_new();
+  if (!comp.worker_started && comp.event_fd != -1)
+    comp.worker_started = pthread_create(&comp.worker, NULL, complete_worker, NULL) == 0;
+  if (comp.worker_started && !(job_equals(comp.current, job) && !comp.done)) {
+    cancel_job();
+    comp.current = job_clone(job);
+    comp.request = job_clone(job);
+    pthread_cond_signal(&comp.wake);
+  }
+  bool started = comp.worker_started;
+  pthread_mutex_unlock(&comp.lock);
+  return started;
+}
+
+static long long monotonic_ms(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+typedef enum {
+  Wait_Done,
+  Wait_Partial,
+  Wait_Cancelled
+} CompleteWait;
+
+/* Sleeps on the worker's eventfd and the terminal together until the job
+ * finishes, the budget runs out, or a key arrives; whatever has been
+ * produced by then is copied into `matches`. */
+static CompleteWait wait_for_job(void) {
+  long long deadline = monotonic_ms() + COMPLETE_BUDGET_MS;
+  struct pollfd fds[2] = {
+    {.fd = rl_instream != NULL ? fileno(rl_instream) : STDIN_FILENO, .events = POLLIN},
+    {.fd = comp.event_fd, .events = POLLIN}
+  };
+  CompleteWait result = Wait_Partial;
+  for (;;) {
+    pthread_mutex_lock(&comp.lock);
+    bool done = comp.done;
+    pthread_mutex_unlock(&comp.lock);
+    if (done) {
+      result = Wait_Done;
+      break;
+    }
+    long long now = monotonic_ms();
+    if (now >= deadline) break;
+    if (rl_pending_input != 0) fds[0].revents = POLLIN;
+    else if (poll(fds, 2, (int)(deadline - now)) < 0) continue;
+    if (fds[0].revents & POLLIN) {
+      pthread_mutex_lock(&comp.lock);
+      cancel_job();
+      pthread_mutex_unlock(&comp.lock);
+      return Wait_Cancelled;
+    }
+    if (fds[1].revents & POLLIN) loop_event_drain(comp.event_fd);
+  }
+  pthread_mutex_lock(&comp.lock);
+  for (size_t i = 0; i < comp.results.len; i++)
+    matches_add(&matches, "", 0, comp.results.items[i], strlen(comp.results.items[i]));
+  pthread_mutex_unlock(&comp.lock);
+  return result;
+}
+
+/* Hands the collected matches to rl_completion_matches(), which takes
+ * ownership of each one and works out the common prefix. */
+static char* next_match(const char* text, int state) {
+  (void)text;
+  if (state == 0) next_index = 0;
+  if (next_index < matches.len) return matches.items[next_index++];
+  matches.len = 0;
+  return NULL;
+}
+
+/* A single match equal to the word leaves the line untouched without the
+ * bell readline rings for an empty result. */
+static char** keep_word(const char* text) {
+  char** result = rmalloc(2 * sizeof(char*));
+  result[0] = rstrdup(text);
+  result[1] = NULL;
+  rl_completion_suppress_append = 1;
+  rl_filename_completion_desired = 0;
+  return result;
+}
+
+static int compare_matches(const void* a, const void* b) {
+  return strcmp(*(char* const*)a, *(char* const*)b);
+}
+
+static void show_partial(const char* text) {
+  if (matches.len == 0 || (rl_completion_query_items > 0 && matches.len >= (size_t)rl_completion_query_items)) return;
+  char** list = rmalloc((matches.len + 2) * sizeof(char*));
+  list[0] = (char*)text;
+  int max_length = 0;
+  for (size_t i = 0; i < matches.len; i++) {
+    list[i + 1] = matches.items[i];
+    int len = (int)strlen(matches.items[i]);
+    if (len > max_length) max_length = len;
+  }
+  list[matches.len + 1] = NULL;
+  qsort(list + 1, matches.len, sizeof(char*), compare_matches);
+  if (rl_completion_display_matches_hook != NULL) {
+    rl_completion_display_matches_hook(list, (int)matches.len, max_length);
+  } else {
+    rl_display_match_list(list, (int)matches.len, max_length);
+    rl_forced_update_display();
+  }
+  rfree(list);
+}
+
+static bool is_command_position(int start) {
+  int i = start - 1;
+  while (i >= 0 && (rl_line_buffer[i] == ' ' || rl_line_buffer[i] == '\t')) i--;
+  return i < 0 || strchr("|;&(", rl_line_buffer[i]) != NULL;
+}
+
+static bool first_word_is(const char* word) {
+  size_t i = 0;
+  while (rl_line_buffer[i] == ' ' || rl_line_buffer[i] == '\t') i++;
+  size_t len = strlen(word);
+  return strncmp(rl_line_buffer + i, word, len) == 0 && (rl_line_buffer[i + len] == ' ' || rl_line_buffer[i + len] == '\t');
+}
+
+static bool ignore_case(void) {
+  const char* value = rl_variable_value("completion-ignore-case");
+  return value != NULL && strcmp(value, "on") == 0;
+}
+
+static void complete_commands(const char* text, size_t len) {
+  for (size_t i = 0; i < BUILTIN_FUNCS_SIZE; i++) {
+    string name = get_builtin_name(i);
+    if (name.len >= len && strncmp(name.str, text, len) == 0) matches_add(&matches, "", 0, name.str, name.len);
+  }
+  size_t first;
+  size_t count = path_index_find_prefix(text, len, &first);
+  for (size_t i = 0; i < count; i++) {
+    const char* name = path_index_name_at(first + i);
+    matches_add(&matches, "", 0, name, strlen(name));
+  }
+}
+
+static CompleteJob file_job(const char* text) {
+  const char* slash = strrchr(text, '/');
+  size_t dir_len = slash != NULL ? (size_t)(slash - text) + 1 : 0;
+
+  StringBuilder path = string_builder__new();
+  const char* dir = text;
+  size_t len = dir_len;
+  if (text[0] == '~' && text[1] == '/') {
+    const char* home = getenv("HOME");
+    string_builder__append_cstr(&path, home != NULL ? home : "");
+    dir++;
+    len--;
+  } else if (text[0] != '/') {
+    const char* cwd = prompt_cwd();
+    string_builder__append_cstr(&path, cwd != NULL ? cwd : ".");
+    string_builder__append_char(&path, '/');
+  }
+  string_builder__append(&path, (string){.str = (char*)dir, .len = len, .is_lit = 1});
+  while (path.len > 1 && path.buffer[path.len - 1] == '/') path.buffer[--path.len] = '\0';
+
+  CompleteJob job = {
+    .dir = rstrdup(path.len > 0 ? path.buffer : "/"),
+    .text = rstrdup(text),
+    .dir_len = dir_len,
+    .fold = ignore_case(),
+    .dirs_only = first_word_is("cd")
+  };
+  string_builder__free(&path);
+  return job;
+}
+
+char** rick__complete(const char* text, int start, int end) {
+  (void)end;
+  rl_attempted_completion_over = 1;
+  matches_clear(&matches);
+  rfree(partial.line);
+  partial.line = NULL;
+  if (is_command_position(start) && strchr(text, '/') == NULL && text[0] != '.' && text[0] != '~') {
+    complete_commands(text, strlen(text));
+  } else {
+    rl_filename_completion_desired = 1;
+    CompleteJob job = file_job(text);
+    bool started = submit_job(&job);
+    rfree(job.dir);
+    rfree(job.text);
+    if (!started) return NULL;
+    switch (wait_for_job()) {
+      case Wait_Done:
+        break;
+      case Wait_Partial:
+        if (rl_completion_type == '?') break;
+        show_partial(text);
+        matches_clear(&matches);
+        rfree(partial.line);
+        partial.line = rstrdup(rl_line_buffer);
+        partial.point = rl_point;
+        return keep_word(text);
+      case Wait_Cancelled:
+        return keep_word(text);
+    }
+  }
+  if (matches.len == 0) return NULL;
+  return rl_completion_matches(text, next_match);
+}
+
+int complete_event_fd(void) {
+  pthread_mutex_lock(&comp.lock);
+  if (comp.event_fd == -1) comp.event_fd = loop_event_new();
+  int fd = comp.event_fd;
+  pthread_mutex_unlock(&comp.lock);
+  return fd;
+}
+
+void complete_deliver(void) {
+  if (comp.event_fd != -1) loop_event_drain(comp.event_fd);
+  if (partial.line == NULL) return;
+  pthread_mutex_lock(&comp.lock);
+  bool done = comp.done;
+  char* text = done && comp.current != NULL ? rstrdup(comp.current->text) : NULL;
+  if (text != NULL)
+    for (size_t i = 0; i < comp.results.len; i++)
+      matches_add(&matches, "", 0, comp.results.items[i], strlen(comp.results.items[i]));
+  pthread_mutex_unlock(&comp.lock);
+  if (!done) return;
+
+  if (text != NULL && rl_point == partial.point && strcmp(rl_line_buffer, partial.line) == 0)
+    show_partial(text);
+  matches_clear(&matches);
+  rfree(text);
+  rfree(partial.line);
+  partial.line = NULL;
+}
+
+void complete_free(void) {
+  if (comp.worker_started) {
+    pthread_mutex_lock(&comp.lock);
+    cancel_job();
+    comp.stop = true;
+    pthread_cond_signal(&comp.wake);
+    pthread_mutex_unlock(&comp.lock);
+    pthread_join(comp.worker, NULL);
+    comp.worker_started = false;
+  }
+  matches_clear(&comp.results);
+  rfree(comp.results.items);
+  comp.results = (CompleteMatches){0};
+  comp.stop = false;
+  matches_clear(&matches);
+  rfree(matches.items);
+  matches = (CompleteMatches){0};
+  rfree(partial.line);
+  partial.line = NULL;
+  if (comp.event_fd != -1) close(comp.event_fd);
+  comp.event_fd = -1;
+  dir_cache_free();
+}
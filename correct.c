@@ -0,0 +1,176 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "correct.h"
+#include "builtin.h"
+#include "pathindex.h"
+#include "memory.h"
+
+/* A BK-tree: every child hangs off its parent under its distance to it, so
+ * by the triangle inequality a search for distance <= k from a node at
+ * distance d only needs the children whose edge lies in [d - k, d + k].
+ * Children form a sibling list; nodes live in one array, names in one arena.
+ * OSA distance bends the triangle inequality for a few transposition cases,
+ * which at worst costs a suggestion, never a wrong one. */
+typedef struct {
+  uint32_t name;
+  uint32_t child;
+  uint32_t sibling;
+  uint8_t len;
+  uint8_t edge;
+} BkNode;
+
+/* Bit-parallel optimal string alignment distance (Levenshtein plus adjacent
+ * swaps) after Hyyro: one pass over `text` with the pattern's columns held
+ * in a machine word, so a comparison costs O(len) instead of O(len^2). */
+typedef struct {
+  uint64_t peq[256];
+  char str[CORRECT_MAX_NAME];
+  size_t len;
+} Pattern;
+
+static void pattern_set(Pattern* p, const char* s, size_t len) {
+  for (size_t i = 0; i < p->len; i++) p->peq[(unsigned char)p->str[i]] = 0;
+  for (size_t i = 0; i < len; i++) p->peq[(unsigned char)s[i]] |= 1ULL << i;
+  memcpy(p->str, s, len);
+  p->len = len;
+}
+
+static size_t correct_distance(const Pattern* p, const char* text, size_t len) {
+  if (p->len == 0) return len;
+  uint64_t top = 1ULL << (p->len - 1);
+  uint64_t vp = ~0ULL, vn = 0, d0 = 0, pm_prev = 0;
+  size_t dist = p->len;
+  for (size_t j = 0; j < len; j++) {
+    uint64_t pm = p->peq[(unsigned char)text[j]];
+    uint64_t tr = (((~d0) & pm) << 1) & pm_prev;
+    d0 = (((pm & vp) + vp) ^ vp) | pm | vn | tr;
+    uint64_t hp = vn | ~(d0 | vp);
+    uint64_t hn = d0 & vp;
+    if (hp & top) dist++;
+    else if (hn & top) dist--;
+    hp = (hp << 1) | 1;
+    hn <<= 1;
+    vp = hn | ~(d0 | hp);
+    vn = hp & d0;
+    pm_prev = pm;
+  }
+  return dist;
+}
+
+static struct {
+  BkNode* nodes;
+  size_t count;
+  size_t capacity;
+  StringBuilder names;
+  unsigned long generation;
+  bool built;
+  uint32_t* stack;
+  Pattern pattern;
+} tree;
+
+static const char* node_name(const BkNode* node) {
+  return tree.names.buffer + node->name;
+}
+
+static void tree_insert(const char* name, size_t len) {
+  if (len == 0 || len > CORRECT_MAX_NAME) return;
+  pattern_set(&tree.pattern, name, len);
+  uint32_t parent = 0;
+  uint8_t edge = 0;
+  if (tree.count > 0) {
+    for (uint32_t at = 0;;) {
+      BkNode* node = &tree.nodes[at];
+      size_t d = correct_distance(&tree.pattern, node_name(node), node->len);
+      if (d == 0) return;
+      uint32_t child = node->child;
+      while (child != 0 && tree.nodes[child].edge != d) child = tree.nodes[child].sibling;
+      if (child == 0) {
+        parent = at;
+        edge = (uint8_t)d;
+        break;
+      }
+      at = child;
+    }
+  }
+
+  if (tree.count == tree.capacity) {
+    tree.capacity = tree.capacity ? tree.capacity * 2 : 1024;
+    tree.nodes = rrealloc(tree.nodes, tree.capacity * sizeof(BkNode));
+  }
+  uint32_t index = (uint32_t)tree.count++;
+  tree.nodes[index] = (BkNode){.name = (uint32_t)tree.names.len, .len = (uint8_t)len, .edge = edge};
+  string_builder__append(&tree.names, (string){.str = (char*)name, .len = len, .is_lit = 1});
+  string_builder__append_char(&tree.names, '\0');
+  if (index > 0) {
+    tree.nodes[index].sibling = tree.nodes[parent].child;
+    tree.nodes[parent].child = index;
+  }
+}
+
+/* Rebuilt whenever the PATH index was, which happens at most once a prompt. */
+static void tree_build(void) {
+  tree.count = 0;
+  tree.names.len = 0;
+  for (size_t i = 0; i < BUILTIN_FUNCS_SIZE; i++) {
+    string name = get_builtin_name(i);
+    tree_insert(name.str, name.len);
+  }
+  size_t total = path_index_count();
+  for (size_t i = 0; i < total; i++) {
+    const char* name = path_index_name_at(i);
+    tree_insert(name, strlen(name));
+  }
+  tree.stack = rrealloc(tree.stack, (tree.count + 1) * sizeof(uint32_t));
+  tree.generation = path_index_generation();
+  tree.built = true;
+}
+
+size_t correct_suggest(const string word, const char** out, size_t max) {
+  if (word.len == 0 || word.len > CORRECT_MAX_NAME || max == 0) return 0;
+  if (!tree.built) tree.names = string_builder__new();
+  if (!tree.built || tree.generation != path_index_generation()) tree_build();
+  if (tree.count == 0) return 0;
+
+  size_t limit = word.len <= 3 ? 1 : CORRECT_MAX_DISTANCE;
+  size_t found = 0, dist[CORRECT_MAX_SUGGESTIONS];
+  if (max > CORRECT_MAX_SUGGESTIONS) max = CORRECT_MAX_SUGGESTIONS;
+
+  pattern_set(&tree.pattern, word.str, word.len);
+  size_t depth = 0;
+  tree.stack[depth++] = 0;
+  while (depth > 0) {
+    const BkNode* node = &tree.nodes[tree.stack[--depth]];
+    const char* name = node_name(node);
+    size_t d = correct_distance(&tree.pattern, name, node->len);
+    if (d <= limit && d < word.len) {
+      size_t at = found < max ? found++ : max;
+      while (at > 0 && (dist[at - 1] > d || (dist[at - 1] == d && strcmp(out[at - 1], name) > 0))) {
+        if (at < max) {
+          out[at] = out[at - 1];
+          dist[at] = dist[at - 1];
+        }
+        at--;
+      }
+      if (at < max) {
+        out[at] = name;
+        dist[at] = d;
+      }
+    }
+    for (uint32_t child = node->child; child != 0; child = tree.nodes[child].sibling) {
+      size_t edge = tree.nodes[child].edge;
+      if (edge + limit >= d && edge <= d + limit) tree.stack[depth++] = child;
+    }
+  }
+  while (found > 1 && dist[found - 1] > dist[0]) found--;
+  return found;
+}
+
+void correct_free(void) {
+  if (tree.built) string_builder__free(&tree.names);
+  rfree(tree.nodes);
+  rfree(tree.stack);
+  memset(&tree, 0, sizeof(tree));
+}
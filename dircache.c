@@ -0,0 +1,205 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include "dircache.h"
+#include "memory.h"
+#include "rstring.h"
+
+#define DIRCACHE_DENTS_BUFFER (32 * 1024)
+
+/* Listings are kept per directory and trusted for as long as the directory's
+ * inode and mtime stay the same. A directory modified within the same second
+ * it was read might have changed again without moving its mtime, so such a
+ * listing is read again on the next lookup. */
+static struct {
+  DirListing dirs[DIRCACHE_MAX_DIRS];
+  size_t count;
+  unsigned long clock;
+} dcache;
+
+static int compare_entries(const void* a, const void* b) {
+  return strcmp(((const DirEntry*)a)->name, ((const DirEntry*)b)->name);
+}
+
+static int compare_folded(const void* a, const void* b, void* arg) {
+  const DirEntry* entries = arg;
+  const DirEntry* x = &entries[*(const size_t*)a];
+  const DirEntry* y = &entries[*(const size_t*)b];
+  int c = strcmp(x->folded, y->folded);
+  return c != 0 ? c : strcmp(x->name, y->name);
+}
+
+static void dir_listing_clear(DirListing* dl) {
+  rfree(dl->names);
+  rfree(dl->entries);
+  rfree(dl->folded_order);
+  dl->names = NULL;
+  dl->entries = NULL;
+  dl->folded_order = NULL;
+  dl->count = 0;
+}
+
+static bool dir_listing_scan(DirListing* dl, const struct stat* st, DirScanVisitor visit, void* ctx) {
+  dir_listing_clear(dl);
+  dl->dev = st->st_dev;
+  dl->ino = st->st_ino;
+  dl->mtime = st->st_mtim;
+  dl->scanned_at = time(NULL);
+
+  int fd = open(dl->path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (fd == -1) return false;
+
+  /* names block holds each name followed by room for its case-folded copy */
+  StringBuilder names = string_builder__new();
+  StringBuilder types = string_builder__new();
+  char* buf = rmalloc(DIRCACHE_DENTS_BUFFER);
+  bool abandoned = false;
+  ssize_t n;
+  while (!abandoned && (n = getdents64(fd, buf, DIRCACHE_DENTS_BUFFER)) > 0) {
+    for (ssize_t off = 0; off < n;) {
+      struct dirent64* d = (struct dirent64*)(buf + off);
+      off += d->d_reclen;
+      if (d->d_name[0] == '.' && (d->d_name[1] == '\0' || (d->d_name[1] == '.' && d->d_name[2] == '\0'))) continue;
+      size_t len = strlen(d->d_name);
+      string_builder__append(&names, (string){.str = d->d_name, .len = len + 1, .is_lit = 1});
+      string_builder__append(&names, (string){.str = d->d_name, .len = len + 1, .is_lit = 1});
+      string_builder__append_char(&types, (char)d->d_type);
+      if (visit != NULL && !visit(d->d_name, len, d->d_type, ctx)) {
+        abandoned = true;
+        break;
+      }
+    }
+  }
+  rfree(buf);
+  close(fd);
+  if (abandoned) {
+    string_builder__free(&names);
+    string_builder__free(&types);
+    return false;
+  }
+
+  dl->count = types.len;
+  dl->names = rmalloc(names.len + 1);
+  memcpy(dl->names, names.buffer, names.len);
+  dl->entries = rmalloc((dl->count + 1) * sizeof(DirEntry));
+  char* p = dl->names;
+  for (size_t i = 0; i < dl->count; i++) {
+    size_t len = strlen(p);
+    dl->entries[i] = (DirEntry){.name = p, .folded = p + len + 1, .len = len, .type = (unsigned char)types.buffer[i]};
+    p += 2 * (len + 1);
+  }
+  string_builder__free(&names);
+  string_builder__free(&types);
+
+  qsort(dl->entries, dl->count, sizeof(DirEntry), compare_entries);
+  return true;
+}
+
+/* The case-folded ordering is only needed with completion-ignore-case, so it
+ * is built the first time a folded lookup asks for it. */
+static void dir_listing_fold(DirListing* dl) {
+  dl->folded_order = rmalloc((dl->count + 1) * sizeof(size_t));
+  for (size_t i = 0; i < dl->count; i++) {
+    char* folded = (char*)dl->entries[i].folded;
+    for (size_t j = 0; j < dl->entries[i].len; j++) folded[j] = (char)tolower((unsigned char)folded[j]);
+    dl->folded_order[i] = i;
+  }
+  qsort_r(dl->folded_order, dl->count, sizeof(size_t), compare_folded, dl->entries);
+}
+
+static bool dir_listing_fresh(const DirListing* dl, const struct stat* st) {
+  return dl->entries != NULL && dl->dev == st->st_dev && dl->ino == st->st_ino &&
+         dl->mtime.tv_sec == st->st_mtim.tv_sec && dl->mtime.tv_nsec == st->st_mtim.tv_nsec &&
+         dl->mtime.tv_sec < dl->scanned_at;
+}
+
+const DirListing* dir_cache_get(const char* path, bool fold, DirScanVisitor visit, void* ctx) {
+  struct stat st;
+  if (stat(path, &st) != 0 || !S_ISDIR(st.st_mode)) return NULL;
+
+  DirListing* slot = NULL;
+  for (size_t i = 0; i < dcache.count; i++) {
+    if (strcmp(dcache.dirs[i].path, path) == 0) {
+      slot = &dcache.dirs[i];
+      break;
+    }
+  }
+  if (slot == NULL) {
+    if (dcache.count < DIRCACHE_MAX_DIRS) {
+      slot = &dcache.dirs[dcache.count++];
+    } else {
+      slot = &dcache.dirs[0];
+      for (size_t i = 1; i < dcache.count; i++)
+        if (dcache.dirs[i].last_used < slot->last_used) slot = &dcache.dirs[i];
+      dir_listing_clear(slot);
+      rfree(slot->path);
+    }
+    memset(slot, 0, sizeof(*slot));
+    slot->path = rstrdup(path);
+  }
+  slot->last_used = ++dcache.clock;
+
+  if (!dir_listing_fresh(slot, &st) && !dir_listing_scan(slot, &st, visit, ctx)) {
+    dir_listing_clear(slot);
+    return NULL;
+  }
+  if (fold && slot->folded_order == NULL) dir_listing_fold(slot);
+  return slot;
+}
+
+const DirEntry* dir_listing_at(const DirListing* dl, size_t pos, bool fold) {
+  return fold ? &dl->entries[dl->folded_order[pos]] : &dl->entries[pos];
+}
+
+static int compare_prefix(const DirEntry* entry, const char* prefix, size_t len, bool fold) {
+  if (!fold) return strncmp(entry->name, prefix, len);
+  for (size_t i = 0; i < len; i++) {
+    int c = (unsigned char)entry->folded[i] - tolower((unsigned char)prefix[i]);
+    if (c != 0 || entry->folded[i] == '\0') return c;
+  }
+  return 0;
+}
+
+size_t dir_listing_find_prefix(const DirListing* dl, const char* prefix, size_t len, bool fold, size_t* first) {
+  size_t lo = 0, hi = dl->count;
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    if (compare_prefix(dir_listing_at(dl, mid, fold), prefix, len, fold) < 0) lo = mid + 1;
+    else hi = mid;
+  }
+  size_t end = lo;
+  hi = dl->count;
+  while (end < hi) {
+    size_t mid = end + (hi - end) / 2;
+    if (compare_prefix(dir_listing_at(dl, mid, fold), prefix, len, fold) <= 0) end = mid + 1;
+    else hi = mid;
+  }
+  *first = lo;
+  return end - lo;
+}
+
+unsigned char dir_entry_type(const DirListing* dl, const DirEntry* entry) {
+  if (entry->type != DT_UNKNOWN && entry->type != DT_LNK) return entry->type;
+  int fd = open(dl->path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (fd == -1) return entry->type;
+  struct stat st;
+  unsigned char type = entry->type;
+  if (fstatat(fd, entry->name, &st, 0) == 0)
+    type = S_ISDIR(st.st_mode) ? DT_DIR : S_ISREG(st.st_mode) ? DT_REG : IFTODT(st.st_mode);
+  close(fd);
+  return type;
+}
+
+void dir_cache_free(void) {
+  for (size_t i = 0; i < dcache.count; i++) {
+    dir_listing_clear(&dcache.dirs[i]);
+    rfree(dcache.dirs[i].path);
+  }
+  memset(&dcache, 0, sizeof(dcache));
+}
@@ -6,6 +6,8 @@
 #include <fcntl.h>
 #include <sys/wait.h>
 #include <errno.h>
+#include <limits.h>
+#include <sys/stat.h>
 #include "expr.h"
 #include "builtin.h"
 #include "pipeline.h"
@@ -19,6 +21,9 @@
 #include "strconv.h"
 #include "rstring.h"
 #include "array.h"
+#include "trace.h"
+#include "pathindex.h"
+#include "correct.h"
 
 extern int yyparse(void);
 extern int yylex_destroy(void);
@@ -70,6 +75,41 @@ int rexecvp(const string __file, StringArray __argv) {
   return result;
 }
 
+/* The index only spares the common case a walk of $PATH; anything execvp
+ * could run must pass, so a miss falls back to the same search it does. */
+static bool command_exists(const string name) {
+  if (string__indexof(name, _SLIT("/")) != -1 || path_index_contains(name)) return true;
+  const char* path = getenv("PATH");
+  if (path == NULL) path = "/bin:/usr/bin";
+  char full[PATH_MAX];
+  for (const char* dir = path;;) {
+    const char* end = strchr(dir, ':');
+    int dir_len = (int)(end != NULL ? (size_t)(end - dir) : strlen(dir));
+    int n = snprintf(full, sizeof(full), "%.*s%s%.*s", dir_len, dir, dir_len > 0 ? "/" : "", (int)name.len, name.str);
+    struct stat st;
+    if (n > 0 && (size_t)n < sizeof(full) && access(full, X_OK) == 0 && stat(full, &st) == 0 && !S_ISDIR(st.st_mode)) {
+      path_index_rescan_dir(dir, (size_t)dir_len);
+      return true;
+    }
+    if (end == NULL) return false;
+    dir = end + 1;
+  }
+}
+
+static void report_unknown_command(const string name) {
+  const char* near[CORRECT_MAX_SUGGESTIONS];
+  size_t found = correct_suggest(name, near, CORRECT_MAX_SUGGESTIONS);
+  ffprintln(stderr, "rickshell: %S: command not found", name);
+  if (found == 0) return;
+  StringBuilder sb = string_builder__new();
+  for (size_t i = 0; i < found; i++) {
+    if (i > 0) string_builder__append_cstr(&sb, ", ");
+    string_builder__append_cstr(&sb, near[i]);
+  }
+  ffprintln(stderr, "Did you mean: %S?", (string){.str = sb.buffer, .len = sb.len, .is_lit = 1});
+  string_builder__free(&sb);
+}
+
 IntResult execute_command(Command* cmd, int* result) {
   register size_t i;
   if (cmd == NULL || cmd->argv.size == 0 || string__is_null_or_empty(*(string*)array_get(cmd->argv, 0))) return Err(
@@ -77,12 +117,14 @@ IntResult execute_command(Command* cmd, int* result) {
     ERRCODE_INVALID_ARGUMENT
   );
 
+  TRACE_BEGIN(expand_start);
   for (i = 0; i < cmd->argv.size; i++) {
     string elem = *(string*)array_get(cmd->argv, i);
     string expanded = expand_variables(variable_table, elem);
     string__free(elem);
     array_index_set(&cmd->argv, i, &expanded);
   }
+  TRACE_END(expand_start, "expand_variables");
 
   string felem = *(string*)array_get(cmd->argv, 0);
   bool should_not_expand = do_not_expand_this_builtin(felem);
@@ -172,29 +214,50 @@ IntResult execute_command(Command* cmd, int* result) {
     array_free(&_argv);
   }
 
+  TRACE_BEGIN(builtin_start);
   *result = execute_builtin(cmd);
+  TRACE_END(builtin_start, "builtin");
   if (*result != -1)
     return Ok(NULL);
 
+  if (!command_exists(felem)) {
+    report_unknown_command(felem);
+    *result = 127;
+    return Ok(NULL);
+  }
+
+  TRACE_BEGIN(fork_start);
   pid_t pid = fork();
+  if (pid > 0) TRACE_END(fork_start, "fork");
   if (pid == -1) {
     return Err(
       _SLIT("Fork failed"),
       ERRCODE_EXEC_FORK_FAILED
     );
   } else if (pid == 0) {
+    TRACE_BEGIN(redirect_start);
     Result r = handle_redirection(cmd);
+    TRACE_END(redirect_start, "handle_redirection");
     if (r.is_err) {
       report_error(r);
       _exit(EXIT_FAILURE);
     }
 
+    TRACE_INSTANT("exec");
+    TRACE_FLUSH();
     rexecvp(felem, cmd->argv);
+    if (errno == ENOENT && string__indexof(felem, _SLIT("/")) == -1) {
+      report_unknown_command(felem);
+      _exit(127);
+    }
     print_error(_SLIT("Execvp failed"));
     _exit(EXIT_FAILURE);
   } else {
     int status;
-    if (waitpid(pid, &status, 0) == -1) {
+    TRACE_BEGIN(wait_start);
+    pid_t waited = waitpid(pid, &status, 0);
+    TRACE_END(wait_start, "waitpid");
+    if (waited == -1) {
       return Err(
         _SLIT("Waitpid failed"),
         ERRCODE_EXEC_WAIT_FAILED
@@ -359,10 +422,12 @@ IntResult parse_and_execute(const string input, int* result) {
   while (cmd != NULL) {
     while (isspace(*cmd)) cmd++;
     if (*cmd != '\0') {
+      TRACE_BEGIN(parse_start);
       yy_scan_string(cmd);
       command_list = NULL;
       *result = yyparse();
       yylex_destroy();
+      TRACE_END(parse_start, "parse");
       
       if (*result == 0) {
         if (command_list != NULL) {
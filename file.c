@@ -78,6 +78,9 @@ int ensure_file_exist(const char *file_path) {
 }
 
 void parse_path() {
+  for (int i = 0; i < path_dir_count; i++) free(path_dirs[i]);
+  path_dir_count = 0;
+
   char *path = getenv("PATH");
   if (!path) return;
 
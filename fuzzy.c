@@ -0,0 +1,384 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <unistd.h>
+#include <signal.h>
+#include <pthread.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#include "fuzzy.h"
+#include "memory.h"
+
+#define FUZZY_SCORE_MATCH 16
+#define FUZZY_GAP_START 3
+#define FUZZY_GAP_EXTENSION 1
+#define FUZZY_BONUS_BOUNDARY 10
+#define FUZZY_BONUS_NONWORD 8
+#define FUZZY_BONUS_CAMEL 7
+#define FUZZY_BONUS_CONSECUTIVE 4
+
+/* Smart case: an all-lowercase query matches either case, any uppercase
+ * letter makes the whole query case-sensitive. */
+typedef struct {
+  unsigned char lower[FUZZY_MAX_QUERY];
+  unsigned char upper[FUZZY_MAX_QUERY];
+  size_t len;
+} FuzzyQuery;
+
+typedef struct {
+  FuzzyMatch items[FUZZY_TOP_K];
+  size_t len;
+  size_t k;
+} FuzzyHeap;
+
+typedef struct {
+  FuzzySet* set;
+  const FuzzyQuery* query;
+  bool narrow;
+  FuzzyHeap heaps[FUZZY_MAX_WORKERS];
+} FuzzyJob;
+
+/* Stripe 0 is scored by the caller, stripes 1.. by the pool threads. */
+static struct {
+  pthread_t threads[FUZZY_MAX_WORKERS];
+  size_t workers;
+  bool started;
+  pthread_mutex_t lock;
+  pthread_cond_t wake;
+  pthread_cond_t finished;
+  unsigned long generation;
+  size_t remaining;
+  bool stop;
+  pid_t owner;
+  FuzzyJob job;
+} pool = {.lock = PTHREAD_MUTEX_INITIALIZER, .wake = PTHREAD_COND_INITIALIZER, .finished = PTHREAD_COND_INITIALIZER};
+
+void fuzzy_set_init(FuzzySet* set) {
+  memset(set, 0, sizeof(*set));
+  set->text = string_builder__new();
+}
+
+void fuzzy_set_add(FuzzySet* set, const char* text, size_t len) {
+  if (set->count + 2 > set->capacity) {
+    set->capacity = set->capacity ? set->capacity * 2 : 1024;
+    set->offsets = rrealloc(set->offsets, set->capacity * sizeof(size_t));
+  }
+  if (set->count == 0) set->offsets[0] = 0;
+  string_builder__append(&set->text, (string){.str = (char*)text, .len = len, .is_lit = 1});
+  set->offsets[++set->count] = set->text.len;
+}
+
+string fuzzy_set_get(const FuzzySet* set, size_t index) {
+  size_t start = set->offsets[index];
+  return (string){.str = set->text.buffer + start, .len = set->offsets[index + 1] - start, .is_lit = 1};
+}
+
+static void fuzzy_set_forget(FuzzySet* set) {
+  rfree(set->last_query);
+  set->last_query = NULL;
+}
+
+void fuzzy_set_free(FuzzySet* set) {
+  string_builder__free(&set->text);
+  rfree(set->offsets);
+  fuzzy_set_forget(set);
+  for (size_t i = 0; i < FUZZY_MAX_WORKERS; i++) rfree(set->hits[i]);
+  memset(set, 0, sizeof(*set));
+}
+
+static void prepare_query(FuzzyQuery* q, const char* query) {
+  bool exact = false;
+  q->len = 0;
+  for (const char* p = query; *p != '\0' && q->len < FUZZY_MAX_QUERY; p++, q->len++)
+    if (isupper((unsigned char)*p)) exact = true;
+  for (size_t i = 0; i < q->len; i++) {
+    unsigned char c = (unsigned char)query[i];
+    q->lower[i] = exact ? c : (unsigned char)tolower(c);
+    q->upper[i] = exact ? c : (unsigned char)toupper(c);
+  }
+}
+
+/* Finds the next byte equal to either `a` or `b`, sixteen bytes at a time. */
+static const char* find_either(const char* s, const char* end, unsigned char a, unsigned char b) {
+#if defined(__SSE2__)
+  const __m128i va = _mm_set1_epi8((char)a);
+  const __m128i vb = _mm_set1_epi8((char)b);
+  while (end - s >= 16) {
+    __m128i chunk = _mm_loadu_si128((const __m128i*)(const void*)s);
+    int mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(chunk, va), _mm_cmpeq_epi8(chunk, vb)));
+    if (mask != 0) return s + __builtin_ctz((unsigned)mask);
+    s += 16;
+  }
+#endif
+  for (; s < end; s++)
+    if ((unsigned char)*s == a || (unsigned char)*s == b) return s;
+  return NULL;
+}
+
+static bool query_char_is(const FuzzyQuery* q, size_t i, char c) {
+  return (unsigned char)c == q->lower[i] || (unsigned char)c == q->upper[i];
+}
+
+static int boundary_bonus(const char* s, const char* at) {
+  if (at == s) return FUZZY_BONUS_BOUNDARY;
+  unsigned char prev = (unsigned char)at[-1], cur = (unsigned char)*at;
+  if (prev == '/' || isspace(prev)) return FUZZY_BONUS_BOUNDARY;
+  if (!isalnum(prev)) return FUZZY_BONUS_NONWORD;
+  if ((islower(prev) && isupper(cur)) || (!isdigit(prev) && isdigit(cur))) return FUZZY_BONUS_CAMEL;
+  return 0;
+}
+
+/* Greedy forward scan to prove the query is a subsequence, then a backward
+ * scan from the last match to find the tightest window, which is scored. */
+static bool match_window(const char* s, size_t len, const FuzzyQuery* q, const char** first, const char** last) {
+  const char* end = s + len;
+  const char* p = s;
+  const char* found = NULL;
+  for (size_t i = 0; i < q->len; i++) {
+    found = find_either(p, end, q->lower[i], q->upper[i]);
+    if (found == NULL) return false;
+    p = found + 1;
+  }
+  *last = found;
+  size_t qi = q->len;
+  for (const char* b = found;; b--) {
+    if (query_char_is(q, qi - 1, *b) && --qi == 0) {
+      *first = b;
+      return true;
+    }
+  }
+}
+
+static int score_candidate(const char* s, size_t len, const FuzzyQuery* q) {
+  const char *first, *last;
+  if (!match_window(s, len, q, &first, &last)) return -1;
+  int score = 0;
+  size_t qi = 0;
+  bool prev_match = false, in_gap = false;
+  for (const char* c = first; c <= last; c++) {
+    if (qi < q->len && query_char_is(q, qi, *c)) {
+      int bonus = boundary_bonus(s, c);
+      if (prev_match && bonus < FUZZY_BONUS_CONSECUTIVE) bonus = FUZZY_BONUS_CONSECUTIVE;
+      if (qi == 0) bonus *= 2;
+      score += FUZZY_SCORE_MATCH + bonus;
+      qi++;
+      prev_match = true;
+      in_gap = false;
+    } else {
+      score -= in_gap ? FUZZY_GAP_EXTENSION : FUZZY_GAP_START;
+      prev_match = false;
+      in_gap = true;
+    }
+  }
+  return score < 0 ? 0 : score;
+}
+
+/* Higher score wins, then the shorter candidate, then the one added first. */
+static bool ranks_below(const FuzzySet* set, FuzzyMatch a, FuzzyMatch b) {
+  if (a.score != b.score) return a.score < b.score;
+  size_t la = set->offsets[a.index + 1] - set->offsets[a.index];
+  size_t lb = set->offsets[b.index + 1] - set->offsets[b.index];
+  if (la != lb) return la > lb;
+  return a.index > b.index;
+}
+
+static void heap_sift_down(const FuzzySet* set, FuzzyHeap* heap, size_t i) {
+  for (;;) {
+    size_t low = i, l = 2 * i + 1, r = l + 1;
+    if (l < heap->len && ranks_below(set, heap->items[l], heap->items[low])) low = l;
+    if (r < heap->len && ranks_below(set, heap->items[r], heap->items[low])) low = r;
+    if (low == i) return;
+    FuzzyMatch tmp = heap->items[i];
+    heap->items[i] = heap->items[low];
+    heap->items[low] = tmp;
+    i = low;
+  }
+}
+
+/* A min-heap of the best `k` so far; its root is the weakest kept match. */
+static void heap_offer(const FuzzySet* set, FuzzyHeap* heap, FuzzyMatch m) {
+  if (heap->len < heap->k) {
+    size_t i = heap->len++;
+    heap->items[i] = m;
+    while (i > 0 && ranks_below(set, heap->items[i], heap->items[(i - 1) / 2])) {
+      FuzzyMatch tmp = heap->items[i];
+      heap->items[i] = heap->items[(i - 1) / 2];
+      heap->items[(i - 1) / 2] = tmp;
+      i = (i - 1) / 2;
+    }
+  } else if (heap->k > 0 && ranks_below(set, heap->items[0], m)) {
+    heap->items[0] = m;
+    heap_sift_down(set, heap, 0);
+  }
+}
+
+static void score_stripe(FuzzyJob* job, size_t stripe) {
+  FuzzySet* set = job->set;
+  FuzzyHeap* heap = &job->heaps[stripe];
+  uint32_t* hits = set->hits[stripe];
+  size_t matched = 0;
+  heap->len = 0;
+  size_t lo = set->count * stripe / set->stripes;
+  size_t hi = set->count * (stripe + 1) / set->stripes;
+  size_t n = job->narrow ? set->hit_count[stripe] : hi - lo;
+  for (size_t i = 0; i < n; i++) {
+    uint32_t index = job->narrow ? hits[i] : (uint32_t)(lo + i);
+    size_t start = set->offsets[index];
+    int score = score_candidate(set->text.buffer + start, set->offsets[index + 1] - start, job->query);
+    if (score < 0) continue;
+    hits[matched++] = index;
+    heap_offer(set, heap, (FuzzyMatch){.index = index, .score = score});
+  }
+  set->hit_count[stripe] = matched;
+}
+
+static void* fuzzy_worker(void* arg) {
+  size_t stripe = (size_t)(uintptr_t)arg;
+  unsigned long seen = 0;
+  pthread_mutex_lock(&pool.lock);
+  for (;;) {
+    while (pool.generation == seen && !pool.stop)
+      pthread_cond_wait(&pool.wake, &pool.lock);
+    if (pool.stop) break;
+    seen = pool.generation;
+    bool mine = stripe < pool.job.set->stripes;
+    pthread_mutex_unlock(&pool.lock);
+
+    if (mine) score_stripe(&pool.job, stripe);
+
+    pthread_mutex_lock(&pool.lock);
+    if (--pool.remaining == 0) pthread_cond_signal(&pool.finished);
+  }
+  pthread_mutex_unlock(&pool.lock);
+  return NULL;
+}
+
+/* A forked child, such as a pipeline stage, inherits the pool's state but
+ * none of its threads. */
+static void forget_pool(void) {
+  pthread_mutex_init(&pool.lock, NULL);
+  pthread_cond_init(&pool.wake, NULL);
+  pthread_cond_init(&pool.finished, NULL);
+  pool.workers = 0;
+  pool.started = false;
+}
+
+/* Pool threads never take the shell's signals, whichever mask the caller
+ * had when the pool was started. */
+static void start_pool(void) {
+  pool.started = true;
+  pool.owner = getpid();
+  long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  size_t wanted = cpus > 1 ? (size_t)cpus - 1 : 0;
+  if (wanted > FUZZY_MAX_WORKERS - 1) wanted = FUZZY_MAX_WORKERS - 1;
+  sigset_t all, old;
+  sigfillset(&all);
+  pthread_sigmask(SIG_SETMASK, &all, &old);
+  for (size_t i = 0; i < wanted; i++) {
+    if (pthread_create(&pool.threads[i], NULL, fuzzy_worker, (void*)(uintptr_t)(i + 1)) != 0) break;
+    pool.workers++;
+  }
+  pthread_sigmask(SIG_SETMASK, &old, NULL);
+}
+
+static const FuzzySet* sort_set;
+
+static int compare_matches(const void* a, const void* b) {
+  FuzzyMatch x = *(const FuzzyMatch*)a, y = *(const FuzzyMatch*)b;
+  if (ranks_below(sort_set, y, x)) return -1;
+  if (ranks_below(sort_set, x, y)) return 1;
+  return 0;
+}
+
+size_t fuzzy_search(FuzzySet* set, const char* query, FuzzyMatch* top, size_t k, size_t* top_len) {
+  if (k > FUZZY_TOP_K) k = FUZZY_TOP_K;
+  if (query[0] == '\0' || set->count == 0) {
+    fuzzy_set_forget(set);
+    *top_len = set->count < k ? set->count : k;
+    for (size_t i = 0; i < *top_len; i++) top[i] = (FuzzyMatch){.index = (uint32_t)i, .score = 0};
+    return set->count;
+  }
+
+  if (pool.started && pool.owner != getpid()) forget_pool();
+  if (!pool.started) start_pool();
+  size_t stripes = set->count / FUZZY_MIN_STRIPE;
+  if (stripes > pool.workers + 1) stripes = pool.workers + 1;
+  if (stripes == 0) stripes = 1;
+  if (stripes != set->stripes) {
+    fuzzy_set_forget(set);
+    set->stripes = stripes;
+    for (size_t s = 0; s < stripes; s++) {
+      size_t size = set->count * (s + 1) / stripes - set->count * s / stripes;
+      set->hits[s] = rrealloc(set->hits[s], (size + 1) * sizeof(uint32_t));
+    }
+  }
+
+  FuzzyQuery q;
+  prepare_query(&q, query);
+  /* Appending to the query, even an uppercase letter that turns on case
+   * sensitivity, can only drop candidates, never add them. */
+  bool narrow = set->last_query != NULL && strncmp(query, set->last_query, strlen(set->last_query)) == 0;
+
+  pthread_mutex_lock(&pool.lock);
+  pool.job.set = set;
+  pool.job.query = &q;
+  pool.job.narrow = narrow;
+  for (size_t s = 0; s < stripes; s++) pool.job.heaps[s].k = k;
+  pool.remaining = pool.workers;
+  pool.generation++;
+  pthread_cond_broadcast(&pool.wake);
+  pthread_mutex_unlock(&pool.lock);
+
+  score_stripe(&pool.job, 0);
+
+  pthread_mutex_lock(&pool.lock);
+  while (pool.remaining > 0) pthread_cond_wait(&pool.finished, &pool.lock);
+  pthread_mutex_unlock(&pool.lock);
+
+  size_t total = 0, gathered = 0;
+  for (size_t s = 0; s < stripes; s++) total += set->hit_count[s];
+  FuzzyMatch* all = rmalloc(stripes * FUZZY_TOP_K * sizeof(FuzzyMatch) + 1);
+  for (size_t s = 0; s < stripes; s++) {
+    memcpy(all + gathered, pool.job.heaps[s].items, pool.job.heaps[s].len * sizeof(FuzzyMatch));
+    gathered += pool.job.heaps[s].len;
+  }
+  sort_set = set;
+  qsort(all, gathered, sizeof(FuzzyMatch), compare_matches);
+  *top_len = gathered < k ? gathered : k;
+  memcpy(top, all, *top_len * sizeof(FuzzyMatch));
+  rfree(all);
+
+  rfree(set->last_query);
+  set->last_query = rstrdup(query);
+  return total;
+}
+
+size_t fuzzy_positions(const string candidate, const char* query, size_t* positions, size_t max) {
+  FuzzyQuery q;
+  prepare_query(&q, query);
+  const char *first, *last;
+  if (q.len == 0 || !match_window(candidate.str, candidate.len, &q, &first, &last)) return 0;
+  size_t n = 0, qi = 0;
+  for (const char* c = first; c <= last && qi < q.len && n < max; c++) {
+    if (query_char_is(&q, qi, *c)) {
+      positions[n++] = (size_t)(c - candidate.str);
+      qi++;
+    }
+  }
+  return n;
+}
+
+void fuzzy_free(void) {
+  if (!pool.started) return;
+  pthread_mutex_lock(&pool.lock);
+  pool.stop = true;
+  pthread_cond_broadcast(&pool.wake);
+  pthread_mutex_unlock(&pool.lock);
+  for (size_t i = 0; i < pool.workers; i++) pthread_join(pool.threads[i], NULL);
+  pool.workers = 0;
+  pool.started = false;
+  pool.stop = false;
+}
@@ -0,0 +1,592 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include "gitstatus.h"
+#include "memory.h"
+#include "loop.h"
+
+#define GIT_INDEX_SIGNATURE "DIRC"
+#define GIT_INDEX_ENTRY_SIZE 62
+#define GIT_INDEX_EXTENDED 0x4000
+#define GIT_INDEX_STAGE_MASK 0x3000
+#define GIT_INDEX_SKIP_WORKTREE 0x4000
+#define GIT_INDEX_INTENT_TO_ADD 0x2000
+#define GIT_SHA1_LEN 20
+
+typedef enum {
+  Git_Clean,
+  Git_Dirty,
+  Git_Unknown
+} GitDirtyState;
+
+typedef struct {
+  size_t path;
+  uint32_t mtime_sec;
+  uint32_t mtime_nsec;
+  uint32_t ino;
+  uint32_t mode;
+  uint32_t size;
+  uint16_t flags;
+  uint16_t ext_flags;
+  unsigned char sha[GIT_SHA1_LEN];
+} GitIndexEntry;
+
+typedef struct {
+  char* root;
+  char* gitdir;
+  char* status;
+  unsigned long last_used;
+  struct timespec head_mtime;
+  char* branch;
+  struct timespec index_mtime;
+  off_t index_size;
+  ino_t index_ino;
+  bool index_usable;
+  GitIndexEntry* entries;
+  size_t entry_count;
+  StringBuilder paths;
+} GitRepo;
+
+/* `repos[i].root` and `.status` are shared with the prompt and guarded by
+ * `lock`; everything else in a repo is only touched by the worker. */
+static struct {
+  pthread_t worker;
+  bool worker_started;
+  pthread_mutex_t lock;
+  pthread_cond_t wake;
+  char* request;
+  bool busy;
+  bool stop;
+  bool changed;
+  int event_fd;
+  GitRepo repos[GITSTATUS_MAX_REPOS];
+  size_t repo_count;
+  unsigned long clock;
+} gstat = {.lock = PTHREAD_MUTEX_INITIALIZER, .wake = PTHREAD_COND_INITIALIZER, .event_fd = -1};
+
+typedef struct {
+  uint32_t h[5];
+  uint64_t len;
+  unsigned char block[64];
+  size_t used;
+} Sha1;
+
+static uint32_t rol32(uint32_t x, int n) {
+  return (x << n) | (x >> (32 - n));
+}
+
+static void sha1_block(Sha1* s, const unsigned char* p) {
+  uint32_t w[80];
+  for (int i = 0; i < 16; i++)
+    w[i] = (uint32_t)p[i * 4] << 24 | (uint32_t)p[i * 4 + 1] << 16 | (uint32_t)p[i * 4 + 2] << 8 | p[i * 4 + 3];
+  for (int i = 16; i < 80; i++)
+    w[i] = rol32(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+  uint32_t a = s->h[0], b = s->h[1], c = s->h[2], d = s->h[3], e = s->h[4];
+  for (int i = 0; i < 80; i++) {
+    uint32_t f, k;
+    if (i < 20) { f = (b & c) | (~b & d); k = 0x5A827999; }
+    else if (i < 40) { f = b ^ c ^ d; k = 0x6ED9EBA1; }
+    else if (i < 60) { f = (b & c) | (b & d) | (c & d); k = 0x8F1BBCDC; }
+    else { f = b ^ c ^ d; k = 0xCA62C1D6; }
+    uint32_t t = rol32(a, 5) + f + e + k + w[i];
+    e = d;
+    d = c;
+    c = rol32(b, 30);
+    b = a;
+    a = t;
+  }
+  s->h[0] += a;
+  s->h[1] += b;
+  s->h[2] += c;
+  s->h[3] += d;
+  s->h[4] += e;
+}
+
+static void sha1_init(Sha1* s) {
+  *s = (Sha1){.h = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0}};
+}
+
+static void sha1_update(Sha1* s, const void* data, size_t len) {
+  const unsigned char* p = data;
+  s->len += len;
+  while (len > 0) {
+    size_t n = 64 - s->used < len ? 64 - s->used : len;
+    memcpy(s->block + s->used, p, n);
+    s->used += n;
+    p += n;
+    len -= n;
+    if (s->used == 64) {
+      sha1_block(s, s->block);
+      s->used = 0;
+    }
+  }
+}
+
+static void sha1_final(Sha1* s, unsigned char out[GIT_SHA1_LEN]) {
+  uint64_t bits = s->len * 8;
+  unsigned char pad = 0x80;
+  sha1_update(s, &pad, 1);
+  pad = 0;
+  while (s->used != 56) sha1_update(s, &pad, 1);
+  unsigned char len[8];
+  for (int i = 0; i < 8; i++) len[i] = (unsigned char)(bits >> (56 - i * 8));
+  sha1_update(s, len, 8);
+  for (int i = 0; i < 5; i++) {
+    out[i * 4] = (unsigned char)(s->h[i] >> 24);
+    out[i * 4 + 1] = (unsigned char)(s->h[i] >> 16);
+    out[i * 4 + 2] = (unsigned char)(s->h[i] >> 8);
+    out[i * 4 + 3] = (unsigned char)s->h[i];
+  }
+}
+
+static long long monotonic_ms(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static char* read_small_file(const char* path, size_t* len) {
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd == -1) return NULL;
+  char* buf = rmalloc(4096);
+  ssize_t n = read(fd, buf, 4095);
+  close(fd);
+  if (n <= 0) {
+    rfree(buf);
+    return NULL;
+  }
+  while (n > 0 && (buf[n - 1] == '\n' || buf[n - 1] == '\r')) n--;
+  buf[n] = '\0';
+  if (len != NULL) *len = (size_t)n;
+  return buf;
+}
+
+static char* join_path(const char* dir, const char* name) {
+  size_t dlen = strlen(dir), nlen = strlen(name);
+  char* path = rmalloc(dlen + nlen + 2);
+  memcpy(path, dir, dlen);
+  path[dlen] = '/';
+  memcpy(path + dlen + 1, name, nlen + 1);
+  return path;
+}
+
+/* Walks up from `cwd` to the nearest directory holding a .git entry and
+ * resolves `gitdir: ...` indirections used by worktrees and submodules. */
+static bool find_repository(const char* cwd, char** root, char** gitdir) {
+  char* dir = rstrdup(cwd);
+  for (;;) {
+    char* dotgit = join_path(strcmp(dir, "/") == 0 ? "" : dir, ".git");
+    struct stat st;
+    if (stat(dotgit, &st) == 0) {
+      if (S_ISDIR(st.st_mode)) {
+        *root = dir;
+        *gitdir = dotgit;
+        return true;
+      }
+      char* link = read_small_file(dotgit, NULL);
+      rfree(dotgit);
+      if (link != NULL && strncmp(link, "gitdir: ", 8) == 0) {
+        *root = dir;
+        *gitdir = link[8] == '/' ? rstrdup(link + 8) : join_path(dir, link + 8);
+        rfree(link);
+        return true;
+      }
+      rfree(link);
+    } else {
+      rfree(dotgit);
+    }
+    char* slash = strrchr(dir, '/');
+    if (slash == NULL || strcmp(dir, "/") == 0) break;
+    if (slash == dir) slash[1] = '\0';
+    else *slash = '\0';
+  }
+  rfree(dir);
+  return false;
+}
+
+static bool timespec_equal(struct timespec a, struct timespec b) {
+  return a.tv_sec == b.tv_sec && a.tv_nsec == b.tv_nsec;
+}
+
+static void refresh_branch(GitRepo* repo) {
+  char* path = join_path(repo->gitdir, "HEAD");
+  struct stat st = {0};
+  if (stat(path, &st) == 0 && repo->branch != NULL && timespec_equal(st.st_mtim, repo->head_mtime)) {
+    rfree(path);
+    return;
+  }
+  size_t len = 0;
+  char* head = read_small_file(path, &len);
+  rfree(path);
+  rfree(repo->branch);
+  repo->branch = NULL;
+  if (head == NULL) return;
+  repo->head_mtime = st.st_mtim;
+  if (strncmp(head, "ref: refs/heads/", 16) == 0) repo->branch = rstrdup(head + 16);
+  else if (strncmp(head, "ref: ", 5) == 0) repo->branch = rstrdup(head + 5);
+  else {
+    if (len > 7) head[7] = '\0';
+    repo->branch = rstrdup(head);
+  }
+  rfree(head);
+}
+
+static uint32_t be32(const unsigned char* p) {
+  return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+}
+
+static uint16_t be16(const unsigned char* p) {
+  return (uint16_t)(p[0] << 8 | p[1]);
+}
+
+static bool parse_index(GitRepo* repo, const unsigned char* data, size_t len) {
+  if (len < 12 || memcmp(data, GIT_INDEX_SIGNATURE, 4) != 0) return false;
+  uint32_t version = be32(data + 4);
+  uint32_t count = be32(data + 8);
+  if (version < 2 || version > 4) return false;
+
+  repo->entries = rrealloc(repo->entries, (count ? count : 1) * sizeof(GitIndexEntry));
+  repo->entry_count = 0;
+  repo->paths.len = 0;
+  size_t prev_path = 0, prev_len = 0;
+  size_t off = 12;
+  for (uint32_t i = 0; i < count; i++) {
+    if (off + GIT_INDEX_ENTRY_SIZE > len) return false;
+    const unsigned char* e = data + off;
+    GitIndexEntry entry = {
+      .mtime_sec = be32(e + 8),
+      .mtime_nsec = be32(e + 12),
+      .ino = be32(e + 20),
+      .mode = be32(e + 24),
+      .size = be32(e + 36),
+      .flags = be16(e + 60),
+    };
+    memcpy(entry.sha, e + 40, GIT_SHA1_LEN);
+    size_t p = off + GIT_INDEX_ENTRY_SIZE;
+    if (entry.flags & GIT_INDEX_EXTENDED) {
+      if (version < 3 || p + 2 > len) return false;
+      entry.ext_flags = be16(data + p);
+      p += 2;
+    }
+
+    entry.path = repo->paths.len;
+    if (version == 4) {
+      size_t strip = 0;
+      unsigned char c;
+      do {
+        if (p >= len) return false;
+        c = data[p++];
+        strip = (strip << 7) | (c & 0x7f);
+        if (c & 0x80) strip++;
+      } while (c & 0x80);
+      if (strip > prev_len) return false;
+      const unsigned char* nul = memchr(data + p, '\0', len - p);
+      if (nul == NULL) return false;
+      size_t keep = prev_len - strip;
+      for (size_t k = 0; k < keep; k++)
+        string_builder__append_char(&repo->paths, repo->paths.buffer[prev_path + k]);
+      string_builder__append(&repo->paths, (string){.str = (char*)data + p, .len = (size_t)(nul - (data + p)), .is_lit = 1});
+      prev_len = keep + (size_t)(nul - (data + p));
+      p = (size_t)(nul - data) + 1;
+    } else {
+      const unsigned char* nul = memchr(data + p, '\0', len - p);
+      if (nul == NULL) return false;
+      size_t name_len = (size_t)(nul - (data + p));
+      string_builder__append(&repo->paths, (string){.str = (char*)data + p, .len = name_len, .is_lit = 1});
+      prev_len = name_len;
+      p = off + ((p - off + name_len + 8) & ~(size_t)7);
+    }
+    string_builder__append_char(&repo->paths, '\0');
+    prev_path = entry.path;
+    repo->entries[repo->entry_count++] = entry;
+    off = p;
+  }
+
+  /* A split index keeps most entries in a shared file we do not read. */
+  return !(off + 8 <= len && memcmp(data + off, "link", 4) == 0);
+}
+
+static void refresh_index(GitRepo* repo) {
+  char* path = join_path(repo->gitdir, "index");
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  rfree(path);
+  struct stat st;
+  if (fd == -1 || fstat(fd, &st) != 0) {
+    if (fd != -1) close(fd);
+    repo->entry_count = 0;
+    repo->index_usable = true;
+    repo->index_mtime = (struct timespec){0};
+    return;
+  }
+  if (timespec_equal(st.st_mtim, repo->index_mtime) && st.st_size == repo->index_size && st.st_ino == repo->index_ino) {
+    close(fd);
+    return;
+  }
+
+  unsigned char* data = rmalloc((size_t)st.st_size + 1);
+  size_t got = 0;
+  while (got < (size_t)st.st_size) {
+    ssize_t n = read(fd, data + got, (size_t)st.st_size - got);
+    if (n <= 0) break;
+    got += (size_t)n;
+  }
+  close(fd);
+  repo->index_usable = got == (size_t)st.st_size && parse_index(repo, data, got);
+  repo->index_mtime = st.st_mtim;
+  repo->index_size = st.st_size;
+  repo->index_ino = st.st_ino;
+  rfree(data);
+}
+
+static bool blob_matches(int rootfd, const char* path, const struct stat* st, const unsigned char* sha) {
+  Sha1 s;
+  sha1_init(&s);
+  char header[32];
+  int hlen = snprintf(header, sizeof(header), "blob %lld", (long long)st->st_size);
+  sha1_update(&s, header, (size_t)hlen + 1);
+
+  if (S_ISLNK(st->st_mode)) {
+    char target[4096];
+    ssize_t n = readlinkat(rootfd, path, target, sizeof(target));
+    if (n < 0 || n != st->st_size) return false;
+    sha1_update(&s, target, (size_t)n);
+  } else {
+    int fd = openat(rootfd, path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1) return false;
+    char buf[65536];
+    off_t total = 0;
+    ssize_t n;
+    while ((n = read(fd, buf, sizeof(buf))) > 0) {
+      sha1_update(&s, buf, (size_t)n);
+      total += n;
+    }
+    close(fd);
+    if (n < 0 || total != st->st_size) return false;
+  }
+  unsigned char out[GIT_SHA1_LEN];
+  sha1_final(&s, out);
+  return memcmp(out, sha, GIT_SHA1_LEN) == 0;
+}
+
+/* Compares tracked files against their index entries the way `git status`
+ * does: cached stat data first, hashing only entries whose stat data moved
+ * or that were written in the same second as the index itself. */
+static GitDirtyState scan_worktree(GitRepo* repo, long long deadline) {
+  if (!repo->index_usable) return Git_Unknown;
+  int rootfd = open(repo->root, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (rootfd == -1) return Git_Unknown;
+
+  GitDirtyState state = Git_Clean;
+  for (size_t i = 0; i < repo->entry_count && state == Git_Clean; i++) {
+    if ((i & 63) == 0 && monotonic_ms() > deadline) {
+      state = Git_Unknown;
+      break;
+    }
+    const GitIndexEntry* entry = &repo->entries[i];
+    const char* path = repo->paths.buffer + entry->path;
+    if (entry->flags & GIT_INDEX_STAGE_MASK) {
+      state = Git_Dirty;
+      break;
+    }
+    if (entry->ext_flags & GIT_INDEX_SKIP_WORKTREE) continue;
+    if (entry->ext_flags & GIT_INDEX_INTENT_TO_ADD) {
+      state = Git_Dirty;
+      break;
+    }
+    uint32_t type = entry->mode & S_IFMT;
+    if (type == S_IFDIR || type == 0160000) continue;
+
+    struct stat st;
+    if (fstatat(rootfd, path, &st, AT_SYMLINK_NOFOLLOW) != 0) {
+      state = Git_Dirty;
+      break;
+    }
+    if ((st.st_mode & S_IFMT) != type || (S_ISREG(st.st_mode) && ((st.st_mode ^ entry->mode) & S_IXUSR))) {
+      state = Git_Dirty;
+      break;
+    }
+    if ((uint32_t)st.st_size != entry->size) {
+      state = Git_Dirty;
+      break;
+    }
+    bool stat_clean = (uint32_t)st.st_mtim.tv_sec == entry->mtime_sec
+      && (uint32_t)st.st_mtim.tv_nsec == entry->mtime_nsec
+      && (uint32_t)st.st_ino == entry->ino;
+    bool racy = (time_t)entry->mtime_sec >= repo->index_mtime.tv_sec;
+    if (stat_clean && !racy) continue;
+    if (!blob_matches(rootfd, path, &st, entry->sha)) state = Git_Dirty;
+  }
+  close(rootfd);
+  return state;
+}
+
+static GitRepo* repository_for(const char* root, const char* gitdir) {
+  GitRepo* slot = NULL;
+  for (size_t i = 0; i < gstat.repo_count; i++) {
+    if (strcmp(gstat.repos[i].root, root) == 0) {
+      slot = &gstat.repos[i];
+      break;
+    }
+  }
+  if (slot == NULL) {
+    pthread_mutex_lock(&gstat.lock);
+    if (gstat.repo_count < GITSTATUS_MAX_REPOS) {
+      slot = &gstat.repos[gstat.repo_count++];
+    } else {
+      slot = &gstat.repos[0];
+      for (size_t i = 1; i < gstat.repo_count; i++)
+        if (gstat.repos[i].last_used < slot->last_used) slot = &gstat.repos[i];
+      rfree(slot->root);
+      rfree(slot->gitdir);
+      rfree(slot->status);
+      rfree(slot->branch);
+      rfree(slot->entries);
+      string_builder__free(&slot->paths);
+    }
+    *slot = (GitRepo){.root = rstrdup(root), .gitdir = rstrdup(gitdir)};
+    pthread_mutex_unlock(&gstat.lock);
+  }
+  slot->last_used = ++gstat.clock;
+  return slot;
+}
+
+static void refresh_repository(const char* cwd) {
+  long long deadline = monotonic_ms() + GITSTATUS_DEADLINE_MS;
+  char *root, *gitdir;
+  if (!find_repository(cwd, &root, &gitdir)) return;
+  GitRepo* repo = repository_for(root, gitdir);
+  rfree(root);
+  rfree(gitdir);
+
+  refresh_branch(repo);
+  refresh_index(repo);
+  GitDirtyState state = scan_worktree(repo, deadline);
+
+  StringBuilder sb = string_builder__new();
+  string_builder__append_cstr(&sb, " (");
+  string_builder__append_cstr(&sb, repo->branch != NULL ? repo->branch : "?");
+  if (state == Git_Dirty) string_builder__append_char(&sb, '*');
+  else if (state == Git_Unknown) string_builder__append_char(&sb, '?');
+  string_builder__append_char(&sb, ')');
+
+  pthread_mutex_lock(&gstat.lock);
+  if (repo->status == NULL || strcmp(repo->status, sb.buffer) != 0) {
+    rfree(repo->status);
+    repo->status = rstrdup(sb.buffer);
+    gstat.changed = true;
+  }
+  pthread_mutex_unlock(&gstat.lock);
+  string_builder__free(&sb);
+}
+
+static void* git_status_worker(void* arg) {
+  (void)arg;
+  pthread_mutex_lock(&gstat.lock);
+  for (;;) {
+    while (gstat.request == NULL && !gstat.stop)
+      pthread_cond_wait(&gstat.wake, &gstat.lock);
+    if (gstat.stop) break;
+    char* cwd = gstat.request;
+    gstat.request = NULL;
+    pthread_mutex_unlock(&gstat.lock);
+
+    refresh_repository(cwd);
+    rfree(cwd);
+
+    pthread_mutex_lock(&gstat.lock);
+    if (gstat.request == NULL) {
+      gstat.busy = false;
+      loop_event_signal(gstat.event_fd);
+    }
+  }
+  pthread_mutex_unlock(&gstat.lock);
+  return NULL;
+}
+
+void git_status_request(const char* cwd) {
+  if (cwd == NULL) return;
+  pthread_mutex_lock(&gstat.lock);
+  if (!gstat.worker_started)
+    gstat.worker_started = pthread_create(&gstat.worker, NULL, git_status_worker, NULL) == 0;
+  if (gstat.worker_started) {
+    rfree(gstat.request);
+    gstat.request = rstrdup(cwd);
+    gstat.busy = true;
+    pthread_cond_signal(&gstat.wake);
+  }
+  pthread_mutex_unlock(&gstat.lock);
+}
+
+bool git_status_lookup(const char* cwd, StringBuilder* out) {
+  if (cwd == NULL) return false;
+  pthread_mutex_lock(&gstat.lock);
+  const GitRepo* best = NULL;
+  size_t best_len = 0;
+  for (size_t i = 0; i < gstat.repo_count; i++) {
+    const GitRepo* repo = &gstat.repos[i];
+    size_t len = strlen(repo->root);
+    bool inside = strncmp(cwd, repo->root, len) == 0 && (cwd[len] == '/' || cwd[len] == '\0' || strcmp(repo->root, "/") == 0);
+    if (inside && repo->status != NULL && len >= best_len) {
+      best = repo;
+      best_len = len;
+    }
+  }
+  if (best != NULL) string_builder__append_cstr(out, best->status);
+  pthread_mutex_unlock(&gstat.lock);
+  return best != NULL;
+}
+
+int git_status_event_fd(void) {
+  pthread_mutex_lock(&gstat.lock);
+  if (gstat.event_fd == -1) gstat.event_fd = loop_event_new();
+  int fd = gstat.event_fd;
+  pthread_mutex_unlock(&gstat.lock);
+  return fd;
+}
+
+bool git_status_pending(void) {
+  pthread_mutex_lock(&gstat.lock);
+  bool busy = gstat.busy || gstat.changed;
+  pthread_mutex_unlock(&gstat.lock);
+  return busy;
+}
+
+bool git_status_changed(void) {
+  pthread_mutex_lock(&gstat.lock);
+  bool changed = gstat.changed;
+  gstat.changed = false;
+  pthread_mutex_unlock(&gstat.lock);
+  return changed;
+}
+
+void git_status_free(void) {
+  if (gstat.worker_started) {
+    pthread_mutex_lock(&gstat.lock);
+    gstat.stop = true;
+    pthread_cond_signal(&gstat.wake);
+    pthread_mutex_unlock(&gstat.lock);
+    pthread_join(gstat.worker, NULL);
+    gstat.worker_started = false;
+  }
+  for (size_t i = 0; i < gstat.repo_count; i++) {
+    GitRepo* repo = &gstat.repos[i];
+    rfree(repo->root);
+    rfree(repo->gitdir);
+    rfree(repo->status);
+    rfree(repo->branch);
+    rfree(repo->entries);
+    string_builder__free(&repo->paths);
+  }
+  gstat.repo_count = 0;
+  rfree(gstat.request);
+  gstat.request = NULL;
+  if (gstat.event_fd != -1) close(gstat.event_fd);
+  gstat.event_fd = -1;
+}
@@ -73,6 +73,21 @@ const HelpInfo builtin_helps[BUILTIN_FUNCS_SIZE] = {
       "  -p  Print all exported variables\n"
     )
   },
+  {
+    _SLIT("fuzzy"),
+    _SLIT("Pick an item interactively by fuzzy search"),
+    _SLIT("fuzzy [-fd] [-q query] [dir]"),
+    _SLIT(
+      "Pick an item interactively by fuzzy search and print it.\n"
+      "Reads the candidates from standard input when it is not a terminal,\n"
+      "otherwise offers the command history.\n"
+      "\n"
+      "Options:\n"
+      "  -f  Offer the files below dir (default .)\n"
+      "  -d  Offer the directories below dir (default .)\n"
+      "  -q  Start with the given query\n"
+    )
+  },
   {
     _SLIT("help"),
     _SLIT("Display help information"),
@@ -110,6 +125,8 @@ const HelpInfo builtin_helps[BUILTIN_FUNCS_SIZE] = {
     _SLIT(
       "Format and print data.\n"
       "\n"
+      "The format is reused as necessary to consume all of the arguments.\n"
+      "\n"
       "Options:\n"
       "  -v  Store the output in the variable var\n"
     )
@@ -0,0 +1,278 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <limits.h>
+#include <sys/stat.h>
+#include "highlight.h"
+#include "builtin.h"
+#include "pathindex.h"
+#include "memory.h"
+#include "expr.h"
+#include "redirect.h"
+#include "pipeline.h"
+#include "parser.tab.h"
+
+extern int yylex(void);
+extern int yylex_destroy(void);
+extern void* yy_scan_bytes(const char* bytes, int len);
+
+#define HIGHLIGHT_CTX_ARGUMENT 0
+#define HIGHLIGHT_CTX_COMMAND  1
+#define HIGHLIGHT_CTX_REDIRECT 2
+
+typedef struct {
+  size_t start;
+  size_t len;
+  size_t scan_end;
+  unsigned char ctx_before;
+  unsigned char ctx_after;
+  unsigned char attr;
+} HighlightToken;
+
+typedef struct {
+  HighlightToken* items;
+  size_t len;
+  size_t capacity;
+} HighlightTokens;
+
+/* Tokens of the last highlighted line. A token only depends on the bytes the
+ * DFA looked at and the command-position context it started in, so an edit
+ * re-lexes from the first token it could have affected and splices the old
+ * tokens back in as soon as lexing lines up with them again. */
+static struct {
+  char* line;
+  size_t len;
+  size_t capacity;
+  HighlightTokens tokens;
+  HighlightTokens scratch;
+  unsigned char* rule_class;
+} hl;
+
+bool command_exists(const string cmd) {
+  return get_builtin_func(cmd) != NULL || path_index_contains(cmd);
+}
+
+const char* highlight_color(HighlightAttr attr) {
+  switch (attr) {
+    case Highlight_Command: return "\x1b[0;32m";
+    case Highlight_Missing: return "\x1b[0;31m";
+    case Highlight_Assign: return "\x1b[0;36m";
+    case Highlight_Quoted: return "\x1b[0;33m";
+    case Highlight_Param: return "\x1b[0;36m";
+    case Highlight_Redirect: return "\x1b[0;35m";
+    case Highlight_Operator: return "\x1b[0;34m";
+    case Highlight_Path: return "\x1b[0;4m";
+    case Highlight_Control: return "\x1b[0;7m";
+    case Highlight_Ghost: return "\x1b[0;90m";
+    default: return "\x1b[0m";
+  }
+}
+
+/* Longest match of the scanner's DFA at `s`. Returns the accepting rule, 0 if
+ * nothing matched; `scan_len` is how far the DFA looked, len + 1 if it ran
+ * off the end while a longer match was still possible. */
+static int lex_match(const char* s, size_t len, size_t* match_len, size_t* scan_len) {
+  const LexTables* t = &rick_lex_tables;
+  int jam_base = t->base[t->states - 1];
+  int state = 1;
+  int rule = 0;
+  size_t i = 0;
+  *match_len = 0;
+  while (i < len) {
+    unsigned char c = t->ec[(unsigned char)s[i]];
+    while (t->chk[t->base[state] + c] != state) {
+      state = t->def[state];
+      if (state >= t->states) c = t->meta[c];
+    }
+    state = t->nxt[t->base[state] + c];
+    i++;
+    if (t->accept[state]) {
+      rule = t->accept[state];
+      *match_len = i;
+    }
+    if (t->base[state] == jam_base) break;
+  }
+  *scan_len = (i == len && t->base[state] != jam_base) ? len + 1 : i;
+  return rule;
+}
+
+/* Replays the matched bytes through the real scanner so the rule's action
+ * decides the class; the default rule only echoes, so it never gets here.
+ * The class only depends on the rule, so each rule is replayed once. */
+static LexTokenClass lex_class(const char* s, size_t len) {
+  yy_scan_bytes(s, (int)len);
+  int token = yylex();
+  LexTokenClass cls;
+  switch (token) {
+    case 0: cls = LexToken_Space; break;
+    case QUOTED_STRING: cls = LexToken_Quoted; break;
+    case PIPE: cls = LexToken_Pipe; break;
+    case LESS: case GREATER: case DGREATER: case LESSAND: case GREATAND: case LESSGREAT: case DGREATAND:
+      cls = LexToken_Redirect;
+      break;
+    case AMPERSAND: case SEMICOLON: case AND: case OR: case LINE_CHAGE: case '(': case ')':
+      cls = LexToken_Operator;
+      break;
+    case IO_NUMBER: cls = LexToken_IoNumber; break;
+    case WORD: cls = LexToken_Word; break;
+    case PARAM_EXPANSION: cls = LexToken_Param; break;
+    default: cls = LexToken_Other; break;
+  }
+  if (token == QUOTED_STRING || token == WORD || token == PARAM_EXPANSION) string__free(yylval.str);
+  yylex_destroy();
+  return cls;
+}
+
+static LexTokenClass lex_token(const char* s, size_t len, size_t* match_len, size_t* scan_len) {
+  int rule = lex_match(s, len, match_len, scan_len);
+  if (rule == 0 || rule == rick_lex_tables.default_rule || *match_len == 0) {
+    *match_len = len > 0 ? 1 : 0;
+    return LexToken_Other;
+  }
+  if (hl.rule_class == NULL) hl.rule_class = rcalloc((size_t)rick_lex_tables.default_rule, 1);
+  if (hl.rule_class[rule] == 0) hl.rule_class[rule] = (unsigned char)(lex_class(s, *match_len) + 1);
+  return (LexTokenClass)(hl.rule_class[rule] - 1);
+}
+
+static void tokens_push(HighlightTokens* tokens, HighlightToken token) {
+  if (tokens->len == tokens->capacity) {
+    tokens->capacity = tokens->capacity ? tokens->capacity * 2 : 64;
+    tokens->items = rrealloc(tokens->items, tokens->capacity * sizeof(HighlightToken));
+  }
+  tokens->items[tokens->len++] = token;
+}
+
+static bool is_assignment(const char* s, size_t len) {
+  if (len == 0 || !(isalpha((unsigned char)s[0]) || s[0] == '_')) return false;
+  for (size_t i = 1; i < len; i++) {
+    if (s[i] == '=') return true;
+    if (!(isalnum((unsigned char)s[i]) || s[i] == '_')) return false;
+  }
+  return false;
+}
+
+static bool path_exists(const char* s, size_t len) {
+  if (len == 0 || len >= PATH_MAX) return false;
+  if (memchr(s, '/', len) == NULL && s[0] != '.' && s[0] != '~') return false;
+  char path[PATH_MAX];
+  size_t off = 0;
+  if (s[0] == '~') {
+    const char* home = getenv("HOME");
+    if (home == NULL) return false;
+    off = strlen(home);
+    if (off + len >= PATH_MAX) return false;
+    memcpy(path, home, off);
+    s++;
+    len--;
+  }
+  memcpy(path + off, s, len);
+  path[off + len] = '\0';
+  struct stat st;
+  return stat(path, &st) == 0;
+}
+
+static HighlightAttr classify(LexTokenClass cls, const char* s, size_t len, unsigned char ctx, unsigned char* next) {
+  *next = ctx;
+  switch (cls) {
+    case LexToken_Space:
+    case LexToken_Other:
+      return Highlight_Plain;
+    case LexToken_Pipe:
+    case LexToken_Operator:
+      *next = HIGHLIGHT_CTX_COMMAND;
+      return Highlight_Operator;
+    case LexToken_Redirect:
+    case LexToken_IoNumber:
+      *next = (unsigned char)(ctx | HIGHLIGHT_CTX_REDIRECT);
+      return Highlight_Redirect;
+    case LexToken_Quoted:
+      *next = (unsigned char)(ctx & HIGHLIGHT_CTX_REDIRECT ? ctx & ~HIGHLIGHT_CTX_REDIRECT : HIGHLIGHT_CTX_ARGUMENT);
+      return Highlight_Quoted;
+    case LexToken_Param:
+      *next = (unsigned char)(ctx & HIGHLIGHT_CTX_REDIRECT ? ctx & ~HIGHLIGHT_CTX_REDIRECT : HIGHLIGHT_CTX_ARGUMENT);
+      return Highlight_Param;
+    case LexToken_Word:
+      if (ctx & HIGHLIGHT_CTX_REDIRECT) {
+        *next = (unsigned char)(ctx & ~HIGHLIGHT_CTX_REDIRECT);
+        return path_exists(s, len) ? Highlight_Path : Highlight_Plain;
+      }
+      if (ctx == HIGHLIGHT_CTX_COMMAND) {
+        if (is_assignment(s, len)) return Highlight_Assign;
+        *next = HIGHLIGHT_CTX_ARGUMENT;
+        return command_exists((string){.str = (char*)s, .len = len, .is_lit = 1}) ? Highlight_Command : Highlight_Missing;
+      }
+      return path_exists(s, len) ? Highlight_Path : Highlight_Plain;
+  }
+  return Highlight_Plain;
+}
+
+void highlight_line(const char* line, size_t len, unsigned char* attrs) {
+  size_t prefix = 0;
+  size_t common = hl.len < len ? hl.len : len;
+  while (prefix < common && hl.line[prefix] == line[prefix]) prefix++;
+  size_t suffix = 0;
+  while (suffix < common - prefix && hl.line[hl.len - 1 - suffix] == line[len - 1 - suffix]) suffix++;
+  /* old bytes [old_tail, hl.len) are the same as new bytes [new_tail, len) */
+  size_t old_tail = hl.len - suffix;
+  size_t new_tail = len - suffix;
+
+  size_t keep = 0;
+  while (keep < hl.tokens.len && hl.tokens.items[keep].scan_end <= prefix) keep++;
+
+  HighlightTokens* fresh = &hl.scratch;
+  fresh->len = 0;
+  size_t pos = keep > 0 ? hl.tokens.items[keep - 1].start + hl.tokens.items[keep - 1].len : 0;
+  unsigned char ctx = keep > 0 ? hl.tokens.items[keep - 1].ctx_after : HIGHLIGHT_CTX_COMMAND;
+  size_t old = keep;
+  size_t resync = hl.tokens.len;
+  while (pos < len) {
+    if (pos >= new_tail) {
+      size_t old_pos = pos - new_tail + old_tail;
+      while (old < hl.tokens.len && hl.tokens.items[old].start < old_pos) old++;
+      if (old < hl.tokens.len && hl.tokens.items[old].start == old_pos && hl.tokens.items[old].ctx_before == ctx) {
+        resync = old;
+        break;
+      }
+    }
+    size_t match_len, scan_len;
+    LexTokenClass cls = lex_token(line + pos, len - pos, &match_len, &scan_len);
+    HighlightToken token = {.start = pos, .len = match_len, .scan_end = pos + scan_len, .ctx_before = ctx};
+    token.attr = (unsigned char)classify(cls, line + pos, match_len, ctx, &token.ctx_after);
+    tokens_push(fresh, token);
+    ctx = token.ctx_after;
+    pos += match_len;
+  }
+
+  size_t reused = hl.tokens.len - resync;
+  size_t total = keep + fresh->len + reused;
+  if (total > hl.tokens.capacity) {
+    hl.tokens.capacity = total * 2;
+    hl.tokens.items = rrealloc(hl.tokens.items, hl.tokens.capacity * sizeof(HighlightToken));
+  }
+  HighlightToken* tail = hl.tokens.items + keep + fresh->len;
+  memmove(tail, hl.tokens.items + resync, reused * sizeof(HighlightToken));
+  memcpy(hl.tokens.items + keep, fresh->items, fresh->len * sizeof(HighlightToken));
+  if (new_tail != old_tail) {
+    for (size_t t = 0; t < reused; t++) {
+      tail[t].start = tail[t].start - old_tail + new_tail;
+      tail[t].scan_end = tail[t].scan_end - old_tail + new_tail;
+    }
+  }
+  hl.tokens.len = total;
+
+  if (len + 1 > hl.capacity) {
+    hl.capacity = (len + 1) * 2;
+    hl.line = rrealloc(hl.line, hl.capacity);
+  }
+  memcpy(hl.line + prefix, line + prefix, len - prefix);
+  hl.len = len;
+
+  for (size_t t = 0; t < hl.tokens.len; t++)
+    memset(attrs + hl.tokens.items[t].start, hl.tokens.items[t].attr, hl.tokens.items[t].len);
+}
+
+void highlight_reset(void) {
+  hl.len = 0;
+  hl.tokens.len = 0;
+}
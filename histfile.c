@@ -0,0 +1,380 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <ctype.h>
+#include <time.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <readline/history.h>
+#include "history.h"
+#include "histstore.h"
+#include "suggest.h"
+#include "variable.h"
+#include "strconv.h"
+#include "memory.h"
+#include "file.h"
+#include "io.h"
+
+#define HISTSET_INITIAL_CAPACITY 1024
+#define HISTFILE_LINE_STACK 512
+#define HISTFILE_HEADER_MAX 64
+#define HISTFILE_LOCK_RETRIES 8
+
+extern VariableTable* variable_table;
+
+typedef struct {
+  uint64_t* slots;
+  size_t capacity;
+  size_t size;
+} HistorySet;
+
+static struct {
+  char* path;
+  int fd;
+  off_t offset;
+  char session[24];
+  size_t file_entries;
+  size_t duplicates;
+  bool truncated;
+  HistorySet seen;
+} histfile = { .fd = -1 };
+
+static uint64_t history_hash(const char* line, size_t len) {
+  uint64_t h = 14695981039346656037ULL;
+  for (size_t i = 0; i < len; i++) {
+    h ^= (unsigned char)line[i];
+    h *= 1099511628211ULL;
+  }
+  return h ? h : 1;
+}
+
+static void history_set_free(HistorySet* set) {
+  rfree(set->slots);
+  set->slots = NULL;
+  set->capacity = 0;
+  set->size = 0;
+}
+
+static void history_set_reset(HistorySet* set, size_t expected) {
+  size_t capacity = HISTSET_INITIAL_CAPACITY;
+  while (capacity < expected * 2) capacity <<= 1;
+  history_set_free(set);
+  set->slots = rcalloc(capacity, sizeof(uint64_t));
+  set->capacity = capacity;
+}
+
+static bool history_set_insert(HistorySet* set, uint64_t h);
+
+static void history_set_grow(HistorySet* set) {
+  HistorySet grown = {0};
+  history_set_reset(&grown, set->capacity);
+  for (size_t i = 0; i < set->capacity; i++)
+    if (set->slots[i]) history_set_insert(&grown, set->slots[i]);
+  history_set_free(set);
+  *set = grown;
+}
+
+static bool history_set_insert(HistorySet* set, uint64_t h) {
+  if ((set->size + 1) * 2 > set->capacity) history_set_grow(set);
+  size_t mask = set->capacity - 1;
+  for (size_t i = (size_t)h & mask;; i = (i + 1) & mask) {
+    if (set->slots[i] == h) return false;
+    if (set->slots[i] == 0) {
+      set->slots[i] = h;
+      set->size++;
+      return true;
+    }
+  }
+}
+
+size_t history_size_limit(void) {
+  long long limit = DEFAULT_HISTSIZE;
+  Variable* var = variable_table ? get_variable(variable_table, _SLIT("HISTSIZE")) : NULL;
+  if (var != NULL && var->value.type == VAR_INTEGER) {
+    limit = var->value._number;
+  } else if (var != NULL && var->value.type == VAR_STRING) {
+    if (ratoll(var->value._str, &limit).is_err) limit = DEFAULT_HISTSIZE;
+  } else {
+    const char* env = getenv("HISTSIZE");
+    if (env != NULL && ratoll((string){.str = (char*)env, .len = strlen(env), .is_lit = 1}, &limit).is_err) limit = DEFAULT_HISTSIZE;
+  }
+  return limit > 0 ? (size_t)limit : 0;
+}
+
+static int history_open_append(const char* path) {
+  return open(path, O_RDWR | O_APPEND | O_CREAT | O_CLOEXEC, 0600);
+}
+
+bool history_is_header(const char* line, size_t len) {
+  return len > 1 && line[0] == '#' && isdigit((unsigned char)line[1]);
+}
+
+/* Locks the file currently at histfile.path, following a rename by another
+ * session's compaction. Offsets into a replaced file are meaningless, so it is
+ * reread from the start and entries already seen are skipped. */
+static bool history_lock(void) {
+  for (int attempt = 0; attempt < HISTFILE_LOCK_RETRIES; attempt++) {
+    if (histfile.fd == -1) {
+      histfile.fd = history_open_append(histfile.path);
+      if (histfile.fd == -1) return false;
+      histfile.offset = 0;
+    }
+    if (flock(histfile.fd, LOCK_EX) == -1) {
+      if (errno == EINTR) continue;
+      return false;
+    }
+    struct stat fst, pst;
+    if (fstat(histfile.fd, &fst) == 0 && stat(histfile.path, &pst) == 0 &&
+        fst.st_ino == pst.st_ino && fst.st_dev == pst.st_dev)
+      return true;
+    flock(histfile.fd, LOCK_UN);
+    close(histfile.fd);
+    histfile.fd = -1;
+  }
+  return false;
+}
+
+static void history_unlock(void) {
+  if (histfile.fd != -1) flock(histfile.fd, LOCK_UN);
+}
+
+bool history_file_open(const char* path) {
+  history_file_close();
+  histfile.path = expand_home_directory(path);
+  if (histfile.path == NULL) return false;
+  histfile.fd = history_open_append(histfile.path);
+  if (histfile.fd == -1) return false;
+  histfile.offset = lseek(histfile.fd, 0, SEEK_END);
+  snprintf(histfile.session, sizeof(histfile.session), "%x%08x",
+    (unsigned int)getpid(), (unsigned int)time(NULL));
+
+  histfile.file_entries = (size_t)history_length;
+  histfile.duplicates = 0;
+  histfile.truncated = history_store_has_older();
+  history_set_reset(&histfile.seen, (size_t)history_length);
+  HIST_ENTRY** list = history_list();
+  for (int i = 0; list != NULL && i < history_length; i++) {
+    if (list[i] == NULL || list[i]->line == NULL) continue;
+    if (!history_set_insert(&histfile.seen, history_hash(list[i]->line, strlen(list[i]->line))))
+      histfile.duplicates++;
+  }
+  return true;
+}
+
+/* Adds the complete records in buf to readline's list and returns the bytes
+ * they span. Imported records are the ones other sessions wrote: this
+ * session's own and lines already seen are skipped, and the rest go to the
+ * store as well. Otherwise every record is taken, as when reloading. */
+static size_t history_add_records(const char* buf, size_t n, bool import, size_t* added) {
+  const char* p = buf;
+  const char* end = buf + n;
+  const char* header = NULL;
+  size_t header_len = 0;
+  while (p < end) {
+    const char* nl = memchr(p, '\n', (size_t)(end - p));
+    if (nl == NULL) break;
+    size_t line_len = (size_t)(nl - p);
+    if (history_is_header(p, line_len)) {
+      header = p;
+      header_len = line_len;
+    } else if (line_len > 0) {
+      const char* sep = header ? memchr(header, ';', header_len) : NULL;
+      bool own = sep != NULL && (size_t)(header + header_len - sep - 1) == strlen(histfile.session) &&
+        memcmp(sep + 1, histfile.session, strlen(histfile.session)) == 0;
+      bool fresh = history_set_insert(&histfile.seen, history_hash(p, line_len));
+      if (!fresh && !own) histfile.duplicates++;
+      if (!import || (fresh && !own)) {
+        char* line = strndup(p, line_len);
+        add_history(line);
+        if (header != NULL) {
+          char* ts = strndup(header, header_len);
+          add_history_time(ts);
+          free(ts);
+        }
+        if (import) suggest_add(history_store_add(line));
+        free(line);
+        (*added)++;
+      }
+      header = NULL;
+    }
+    p = nl + 1;
+  }
+  return (size_t)(p - buf);
+}
+
+/* Pulls in records other sessions appended after histfile.offset. Must be
+ * called with the lock held. */
+static size_t history_read_tail(void) {
+  struct stat st;
+  if (fstat(histfile.fd, &st) == -1) return 0;
+  if (st.st_size < histfile.offset) histfile.offset = st.st_size;
+  if (st.st_size == histfile.offset) return 0;
+
+  size_t len = (size_t)(st.st_size - histfile.offset);
+  char* buf = rmalloc(len);
+  ssize_t n = pread(histfile.fd, buf, len, histfile.offset);
+  if (n <= 0) {
+    rfree(buf);
+    return 0;
+  }
+
+  size_t added = 0;
+  histfile.offset += (off_t)history_add_records(buf, (size_t)n, true, &added);
+  histfile.file_entries += added;
+  rfree(buf);
+  return added;
+}
+
+bool history_file_read_new(void) {
+  if (histfile.path == NULL || !history_lock()) return false;
+  history_read_tail();
+  history_unlock();
+  return true;
+}
+
+/* `history -r`: replaces readline's list with the file's records. The store
+ * keeps what it has, so Ctrl-R is unaffected. */
+bool history_file_reload(void) {
+  if (histfile.path == NULL || !history_lock()) return false;
+  history_read_tail();
+  char* buf = histfile.offset > 0 ? rmalloc((size_t)histfile.offset) : NULL;
+  ssize_t n = buf != NULL ? pread(histfile.fd, buf, (size_t)histfile.offset, 0) : 0;
+  history_unlock();
+  if (n < 0) {
+    rfree(buf);
+    return false;
+  }
+
+  clear_history();
+  history_set_reset(&histfile.seen, (size_t)histfile.file_entries);
+  histfile.duplicates = 0;
+  size_t added = 0;
+  history_add_records(buf, (size_t)n, false, &added);
+  histfile.file_entries = added;
+  histfile.truncated = false;
+  rfree(buf);
+  return true;
+}
+
+bool history_file_append(const char* line) {
+  if (line == NULL) return false;
+  size_t len = strlen(line);
+  if (len == 0) return false;
+
+  char header[HISTFILE_HEADER_MAX];
+  int header_len = snprintf(header, sizeof(header), "#%lld;%s", (long long)time(NULL), histfile.session);
+  add_history(line);
+  add_history_time(header);
+  suggest_add(history_store_add(line));
+  if (histfile.path == NULL) return false;
+  if (!history_set_insert(&histfile.seen, history_hash(line, len))) return true;
+
+  size_t record_len = (size_t)header_len + len + 2;
+  char stack[HISTFILE_LINE_STACK];
+  char* buf = record_len <= sizeof(stack) ? stack : rmalloc(record_len);
+  memcpy(buf, header, (size_t)header_len);
+  buf[header_len] = '\n';
+  memcpy(buf + header_len + 1, line, len);
+  buf[record_len - 1] = '\n';
+
+  ssize_t written = -1;
+  if (history_lock()) {
+    written = _write(histfile.fd, buf, record_len);
+    history_unlock();
+  }
+  if (buf != stack) rfree(buf);
+  if (written != (ssize_t)record_len) return false;
+
+  histfile.file_entries++;
+  size_t limit = history_size_limit();
+  if (limit > 0 && histfile.file_entries > limit * HISTFILE_COMPACT_FACTOR)
+    history_file_compact();
+  return true;
+}
+
+bool history_file_compact(void) {
+  if (histfile.path == NULL || !history_lock()) return false;
+  history_read_tail();
+
+  size_t limit = history_size_limit();
+  HIST_ENTRY** list = history_list();
+  size_t count = list ? (size_t)history_length : 0;
+  HistorySet kept = {0};
+  history_set_reset(&kept, count);
+
+  /* Walk newest to oldest so a repeated command keeps its latest position. */
+  HIST_ENTRY** entries = rcalloc(count ? count : 1, sizeof(HIST_ENTRY*));
+  size_t nentries = 0;
+  size_t total = 0;
+  for (size_t i = count; i-- > 0 && (limit == 0 || nentries < limit);) {
+    if (list[i] == NULL || list[i]->line == NULL || list[i]->line[0] == '\0') continue;
+    size_t len = strlen(list[i]->line);
+    if (!history_set_insert(&kept, history_hash(list[i]->line, len))) continue;
+    entries[nentries++] = list[i];
+    total += len + 1 + (list[i]->timestamp ? strlen(list[i]->timestamp) + 1 : 0);
+  }
+
+  StringBuilder sb = string_builder__with_capacity(total + 1);
+  for (size_t i = nentries; i-- > 0;) {
+    const char* ts = entries[i]->timestamp;
+    if (ts != NULL && history_is_header(ts, strlen(ts))) {
+      string_builder__append_cstr(&sb, ts);
+      string_builder__append(&sb, _SLIT("\n"));
+    }
+    string_builder__append_cstr(&sb, entries[i]->line);
+    string_builder__append(&sb, _SLIT("\n"));
+  }
+  rfree(entries);
+
+  size_t path_len = strlen(histfile.path);
+  char* tmp = rmalloc(path_len + sizeof(".tmp"));
+  memcpy(tmp, histfile.path, path_len);
+  memcpy(tmp + path_len, ".tmp", sizeof(".tmp"));
+
+  bool ok = false;
+  int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+  if (fd != -1) {
+    ok = _write(fd, sb.buffer, sb.len) == (ssize_t)sb.len;
+    ok = close(fd) == 0 && ok;
+    if (ok) ok = rename(tmp, histfile.path) == 0;
+    if (!ok) unlink(tmp);
+  }
+  rfree(tmp);
+
+  if (ok) {
+    int old_fd = histfile.fd;
+    histfile.fd = history_open_append(histfile.path);
+    histfile.offset = (off_t)sb.len;
+    flock(old_fd, LOCK_UN);
+    close(old_fd);
+    history_set_free(&histfile.seen);
+    histfile.seen = kept;
+    histfile.file_entries = nentries;
+    histfile.duplicates = 0;
+    histfile.truncated = false;
+  } else {
+    history_unlock();
+    history_set_free(&kept);
+  }
+  string_builder__free(&sb);
+  return ok;
+}
+
+void history_file_close(void) {
+  if (histfile.path != NULL) {
+    size_t limit = history_size_limit();
+    if (histfile.truncated || (limit > 0 && histfile.file_entries > limit) ||
+        histfile.duplicates * HISTFILE_DUPLICATE_RATIO > histfile.file_entries)
+      history_file_compact();
+  }
+  if (histfile.fd != -1) close(histfile.fd);
+  histfile.fd = -1;
+  rfree(histfile.path);
+  histfile.path = NULL;
+  history_set_free(&histfile.seen);
+}
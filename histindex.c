@@ -0,0 +1,128 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "histindex.h"
+#include "histstore.h"
+#include "memory.h"
+
+#define HISTINDEX_INITIAL_CAPACITY 4096
+#define HISTINDEX_TRIGRAM(p) \
+  ((((uint32_t)(unsigned char)(p)[0]) << 16 | ((uint32_t)(unsigned char)(p)[1]) << 8 | (uint32_t)(unsigned char)(p)[2]) + 1)
+
+typedef struct {
+  uint32_t trigram;
+  uint32_t size;
+  uint32_t capacity;
+  uint32_t* ids;
+} Posting;
+
+static struct {
+  Posting* slots;
+  size_t capacity;
+  size_t size;
+  size_t indexed;
+} index_ctx;
+
+static Posting* history_index_probe(uint32_t trigram) {
+  size_t mask = index_ctx.capacity - 1;
+  size_t i = (trigram * 2654435761u) & mask;
+  while (index_ctx.slots[i].trigram != 0 && index_ctx.slots[i].trigram != trigram)
+    i = (i + 1) & mask;
+  return &index_ctx.slots[i];
+}
+
+static void history_index_grow(void) {
+  Posting* old = index_ctx.slots;
+  size_t old_capacity = index_ctx.capacity;
+  index_ctx.capacity = old_capacity ? old_capacity * 2 : HISTINDEX_INITIAL_CAPACITY;
+  index_ctx.slots = rcalloc(index_ctx.capacity, sizeof(Posting));
+  for (size_t i = 0; i < old_capacity; i++)
+    if (old[i].trigram != 0) *history_index_probe(old[i].trigram) = old[i];
+  rfree(old);
+}
+
+static Posting* history_index_find(uint32_t trigram) {
+  if (index_ctx.capacity == 0) return NULL;
+  Posting* p = history_index_probe(trigram);
+  return p->trigram != 0 ? p : NULL;
+}
+
+static Posting* history_index_insert(uint32_t trigram) {
+  if ((index_ctx.size + 1) * 2 > index_ctx.capacity) history_index_grow();
+  Posting* p = history_index_probe(trigram);
+  if (p->trigram == 0) {
+    p->trigram = trigram;
+    index_ctx.size++;
+  }
+  return p;
+}
+
+static void history_index_add(uint32_t id, const string line) {
+  for (size_t i = 0; i + 3 <= line.len; i++) {
+    Posting* p = history_index_insert(HISTINDEX_TRIGRAM(line.str + i));
+    if (p->size > 0 && p->ids[p->size - 1] == id) continue;
+    if (p->size == p->capacity) {
+      p->capacity = p->capacity ? p->capacity * 2 : 4;
+      p->ids = rrealloc(p->ids, p->capacity * sizeof(uint32_t));
+    }
+    p->ids[p->size++] = id;
+  }
+}
+
+/* Entries only ever get appended to the store, so catching up is O(new). */
+static void history_index_update(void) {
+  size_t count = history_store_count();
+  for (; index_ctx.indexed < count; index_ctx.indexed++)
+    history_index_add((uint32_t)index_ctx.indexed, history_store_get(index_ctx.indexed));
+}
+
+static bool history_entry_matches(size_t id, const string query) {
+  string entry = history_store_get(id);
+  return entry.len >= query.len && memmem(entry.str, entry.len, query.str, query.len) != NULL;
+}
+
+bool history_index_search(const string query, size_t before, size_t* found) {
+  history_index_update();
+  if (before > index_ctx.indexed) before = index_ctx.indexed;
+  if (query.len == 0) return false;
+
+  if (query.len < 3) {
+    for (size_t id = before; id-- > 0;) {
+      if (history_entry_matches(id, query)) {
+        *found = id;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  const Posting* rarest = NULL;
+  for (size_t i = 0; i + 3 <= query.len; i++) {
+    const Posting* p = history_index_find(HISTINDEX_TRIGRAM(query.str + i));
+    if (p == NULL || p->size == 0) return false;
+    if (rarest == NULL || p->size < rarest->size) rarest = p;
+  }
+
+  size_t lo = 0, hi = rarest->size;
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    if (rarest->ids[mid] < before) lo = mid + 1;
+    else hi = mid;
+  }
+  for (size_t i = lo; i-- > 0;) {
+    if (history_entry_matches(rarest->ids[i], query)) {
+      *found = rarest->ids[i];
+      return true;
+    }
+  }
+  return false;
+}
+
+void history_index_free(void) {
+  for (size_t i = 0; i < index_ctx.capacity; i++)
+    rfree(index_ctx.slots[i].ids);
+  rfree(index_ctx.slots);
+  memset(&index_ctx, 0, sizeof(index_ctx));
+}
@@ -0,0 +1,233 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <pthread.h>
+#include <readline/history.h>
+#include "histstore.h"
+#include "history.h"
+#include "memory.h"
+#include "file.h"
+
+#define HISTSTORE_ARENA_BLOCK (64 * 1024)
+#define HISTSTORE_INDEX_INITIAL 1024
+
+typedef struct ArenaBlock {
+  struct ArenaBlock* next;
+  size_t used;
+  size_t capacity;
+  char data[];
+} ArenaBlock;
+
+static pthread_mutex_t store_index_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static struct {
+  const char* map;
+  size_t map_len;
+  size_t* offsets;
+  size_t indexed;
+  bool index_built;
+  bool has_older;
+  ArenaBlock* arena;
+  string* session;
+  size_t session_count;
+  size_t session_capacity;
+} store;
+
+bool history_store_open(const char* path) {
+  history_store_close();
+  char* full = expand_home_directory(path);
+  if (full == NULL) return false;
+  int fd = open(full, O_RDONLY | O_CLOEXEC);
+  rfree(full);
+  if (fd == -1) return false;
+
+  struct stat st;
+  if (fstat(fd, &st) == -1 || st.st_size <= 0) {
+    close(fd);
+    return st.st_size == 0;
+  }
+
+  void* map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) return false;
+  store.map = map;
+  store.map_len = (size_t)st.st_size;
+  return true;
+}
+
+/* Feeds readline only the newest entries, scanning backwards from the end of
+ * the mapping so startup cost does not depend on the size of the file. */
+size_t history_store_load_recent(size_t max_entries) {
+  if (store.map == NULL) return 0;
+
+  const char* begin = store.map;
+  const char* end = store.map + store.map_len;
+  if (end > begin && end[-1] == '\n') end--;
+
+  const char* start = end;
+  size_t found = 0;
+  store.has_older = false;
+  while (start > begin) {
+    const char* nl = memrchr(begin, '\n', (size_t)(start - begin));
+    if (nl == NULL) {
+      start = begin;
+      break;
+    }
+    if (history_is_header(nl + 1, (size_t)(end - nl - 1))) {
+      start = nl;
+      continue;
+    }
+    if (max_entries > 0 && ++found == max_entries) {
+      const char* prev = memrchr(begin, '\n', (size_t)(nl - begin));
+      const char* header = prev ? prev + 1 : begin;
+      start = history_is_header(header, (size_t)(nl - header)) ? header : nl + 1;
+      store.has_older = start > begin;
+      break;
+    }
+    start = nl;
+  }
+  if (start < end && *start == '\n') start++;
+
+  char* scratch = NULL;
+  size_t scratch_len = 0;
+  size_t loaded = 0;
+  const char* header = NULL;
+  size_t header_len = 0;
+  for (const char* line = start; line < end;) {
+    const char* nl = memchr(line, '\n', (size_t)(end - line));
+    size_t len = (size_t)((nl ? nl : end) - line);
+    if (history_is_header(line, len)) {
+      header = line;
+      header_len = len;
+    } else if (len > 0) {
+      if (len + 1 > scratch_len) {
+        rfree(scratch);
+        scratch_len = len + 1 > 256 ? len + 1 : 256;
+        scratch = rmalloc(scratch_len);
+      }
+      memcpy(scratch, line, len);
+      scratch[len] = '\0';
+      add_history(scratch);
+      if (header != NULL) {
+        if (header_len + 1 > scratch_len) {
+          rfree(scratch);
+          scratch_len = header_len + 1;
+          scratch = rmalloc(scratch_len);
+        }
+        memcpy(scratch, header, header_len);
+        scratch[header_len] = '\0';
+        add_history_time(scratch);
+        header = NULL;
+      }
+      loaded++;
+    }
+    line += len + 1;
+  }
+  rfree(scratch);
+  return loaded;
+}
+
+bool history_store_has_older(void) {
+  return store.has_older;
+}
+
+/* The suggestion index is built from a worker thread, so the one-time build
+ * is serialised. Once built, the file part of the index is read-only. */
+static void history_store_build_index(void) {
+  pthread_mutex_lock(&store_index_mutex);
+  if (store.index_built || store.map == NULL) {
+    store.index_built = true;
+    pthread_mutex_unlock(&store_index_mutex);
+    return;
+  }
+
+  size_t capacity = HISTSTORE_INDEX_INITIAL;
+  store.offsets = rmalloc(capacity * sizeof(size_t));
+  const char* p = store.map;
+  const char* end = store.map + store.map_len;
+  while (p < end) {
+    if (store.indexed == capacity) {
+      capacity *= 2;
+      store.offsets = rrealloc(store.offsets, capacity * sizeof(size_t));
+    }
+    const char* nl = memchr(p, '\n', (size_t)(end - p));
+    size_t len = (size_t)((nl ? nl : end) - p);
+    if (len > 0 && !history_is_header(p, len))
+      store.offsets[store.indexed++] = (size_t)(p - store.map);
+    if (nl == NULL) break;
+    p = nl + 1;
+  }
+  store.index_built = true;
+  pthread_mutex_unlock(&store_index_mutex);
+}
+
+size_t history_store_file_count(void) {
+  history_store_build_index();
+  return store.indexed;
+}
+
+size_t history_store_count(void) {
+  history_store_build_index();
+  return store.indexed + store.session_count;
+}
+
+string history_store_get(size_t index) {
+  history_store_build_index();
+  if (index >= store.indexed) {
+    index -= store.indexed;
+    return index < store.session_count ? store.session[index] : _SLIT0;
+  }
+
+  const char* begin = store.map + store.offsets[index];
+  const char* nl = memchr(begin, '\n', store.map_len - store.offsets[index]);
+  size_t len = nl ? (size_t)(nl - begin) : store.map_len - store.offsets[index];
+  return (string){.str = (char*)begin, .len = len, .is_lit = 1};
+}
+
+static char* history_store_arena_alloc(size_t size) {
+  ArenaBlock* block = store.arena;
+  if (block == NULL || block->capacity - block->used < size) {
+    size_t capacity = size > HISTSTORE_ARENA_BLOCK ? size : HISTSTORE_ARENA_BLOCK;
+    block = rmalloc(sizeof(ArenaBlock) + capacity);
+    block->next = store.arena;
+    block->used = 0;
+    block->capacity = capacity;
+    store.arena = block;
+  }
+  char* ptr = block->data + block->used;
+  block->used += size;
+  return ptr;
+}
+
+string history_store_add(const char* line) {
+  if (line == NULL) return _SLIT0;
+  size_t len = strlen(line);
+  if (len == 0) return _SLIT0;
+
+  char* copy = history_store_arena_alloc(len + 1);
+  memcpy(copy, line, len + 1);
+  if (store.session_count == store.session_capacity) {
+    store.session_capacity = store.session_capacity ? store.session_capacity * 2 : 64;
+    store.session = rrealloc(store.session, store.session_capacity * sizeof(string));
+  }
+  store.session[store.session_count++] = (string){.str = copy, .len = len, .is_lit = 1};
+  return store.session[store.session_count - 1];
+}
+
+void history_store_close(void) {
+  if (store.map != NULL) munmap((void*)store.map, store.map_len);
+  rfree(store.offsets);
+  rfree(store.session);
+  ArenaBlock* block = store.arena;
+  while (block != NULL) {
+    ArenaBlock* next = block->next;
+    rfree(block);
+    block = next;
+  }
+  memset(&store, 0, sizeof(store));
+}
@@ -4,7 +4,7 @@
 #include "rstring.h"
 
 typedef int (*builtin_func)(Command* cmd);
-#define BUILTIN_FUNCS_SIZE 11
+#define BUILTIN_FUNCS_SIZE 12
 
 typedef struct {
   const string name;
@@ -16,6 +16,7 @@ int builtin_declare(Command *cmd);
 int builtin_echo(Command *cmd);
 int builtin_exit(Command *cmd);
 int builtin_export(Command *cmd);
+int builtin_fuzzy(Command *cmd);
 int builtin_help(Command *cmd);
 int builtin_history(Command *cmd);
 int builtin_printf(Command *cmd);
@@ -25,6 +26,7 @@ int builtin_unset(Command *cmd);
 
 int execute_builtin(Command* cmd);
 builtin_func get_builtin_func(const string name);
+string get_builtin_name(size_t index);
 
 typedef struct {
   const string name;
@@ -17,6 +17,7 @@
 #define ANSI_COLOR_BOLD_MAGENTA "\x1b[1;35m"
 #define ANSI_COLOR_BOLD_CYAN    "\x1b[1;36m"
 #define ANSI_COLOR_BOLD_WHITE   "\x1b[1;37m"
+#define ANSI_COLOR_BRIGHT_BLACK        "\x1b[90m"
 #define ANSI_COLOR_BRIGHT_BOLD_BLACK   "\x1b[1;90m"
 #define ANSI_COLOR_BRIGHT_BOLD_RED     "\x1b[1;91m"
 #define ANSI_COLOR_BRIGHT_BOLD_GREEN   "\x1b[1;92m"
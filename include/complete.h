@@ -0,0 +1,13 @@
+#ifndef __RICKSHELL_COMPLETE_H__
+#define __RICKSHELL_COMPLETE_H__
+#define COMPLETE_BUDGET_MS 150
+
+/* rl_attempted_completion_function: commands from the builtins and the PATH
+ * index, everything else from the directory listing cache. */
+char** rick__complete(const char* text, int start, int end);
+/* Readable while the filename worker has news for complete_deliver(). */
+int complete_event_fd(void);
+/* Shows the full list once a job that only had a partial list finishes. */
+void complete_deliver(void);
+void complete_free(void);
+#endif /* __RICKSHELL_COMPLETE_H__ */
@@ -0,0 +1,17 @@
+#ifndef __RICKSHELL_CORRECT_H__
+#define __RICKSHELL_CORRECT_H__
+#include <stddef.h>
+#include "rstring.h"
+#define CORRECT_MAX_NAME 64
+#define CORRECT_MAX_DISTANCE 2
+#define CORRECT_MAX_SUGGESTIONS 3
+
+/**
+ * Finds the known command names closest to `word` by Damerau-Levenshtein
+ * distance; only the ones at the smallest distance found are returned. Names
+ * point into the index and stay valid until the next call.
+ * @return the number of names written to `out`
+ */
+size_t correct_suggest(const string word, const char** out, size_t max);
+void correct_free(void);
+#endif /* __RICKSHELL_CORRECT_H__ */
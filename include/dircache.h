@@ -0,0 +1,49 @@
+#ifndef __RICKSHELL_DIRCACHE_H__
+#define __RICKSHELL_DIRCACHE_H__
+#include <stdbool.h>
+#include <stddef.h>
+#include <time.h>
+#include <sys/types.h>
+#define DIRCACHE_MAX_DIRS 64
+
+typedef struct {
+  const char* name;
+  const char* folded;
+  size_t len;
+  unsigned char type;
+} DirEntry;
+
+typedef struct {
+  char* path;
+  dev_t dev;
+  ino_t ino;
+  struct timespec mtime;
+  time_t scanned_at;
+  char* names;
+  DirEntry* entries;
+  size_t* folded_order;
+  size_t count;
+  unsigned long last_used;
+} DirListing;
+
+/* Sees each entry while a directory is being read; returning false abandons the read. */
+typedef bool (*DirScanVisitor)(const char* name, size_t len, unsigned char type, void* ctx);
+
+/**
+ * @param fold  also prepare the case-folded ordering for dir_listing_find_prefix()
+ * @param visit  optional; only called when the directory actually has to be read
+ * @return the cached listing of `path`, rescanned only if the directory changed;
+ *         valid until the next dir_cache_get() call, NULL if it cannot be read
+ */
+const DirListing* dir_cache_get(const char* path, bool fold, DirScanVisitor visit, void* ctx);
+/**
+ * Finds the sorted run of entries whose name starts with `prefix`.
+ * With `fold` the run is taken from the case-folded ordering instead.
+ * @return the number of matching entries; the first is at sorted position *first
+ */
+size_t dir_listing_find_prefix(const DirListing* dl, const char* prefix, size_t len, bool fold, size_t* first);
+const DirEntry* dir_listing_at(const DirListing* dl, size_t pos, bool fold);
+/* Resolves DT_UNKNOWN (and symlinks) to the type of the target. */
+unsigned char dir_entry_type(const DirListing* dl, const DirEntry* entry);
+void dir_cache_free(void);
+#endif /* __RICKSHELL_DIRCACHE_H__ */
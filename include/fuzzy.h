@@ -0,0 +1,45 @@
+#ifndef __RICKSHELL_FUZZY_H__
+#define __RICKSHELL_FUZZY_H__
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "rstring.h"
+#define FUZZY_MAX_WORKERS 8
+#define FUZZY_MIN_STRIPE 8192
+#define FUZZY_TOP_K 256
+#define FUZZY_MAX_QUERY 128
+
+typedef struct {
+  uint32_t index;
+  int32_t score;
+} FuzzyMatch;
+
+/* Candidates are stored back to back in one arena. The hit lists remember
+ * which candidates matched the previous query, so a query that only grew
+ * re-scores those instead of the whole set. */
+typedef struct {
+  StringBuilder text;
+  size_t* offsets;
+  size_t count;
+  size_t capacity;
+  char* last_query;
+  size_t stripes;
+  uint32_t* hits[FUZZY_MAX_WORKERS];
+  size_t hit_count[FUZZY_MAX_WORKERS];
+} FuzzySet;
+
+void fuzzy_set_init(FuzzySet* set);
+void fuzzy_set_add(FuzzySet* set, const char* text, size_t len);
+string fuzzy_set_get(const FuzzySet* set, size_t index);
+void fuzzy_set_free(FuzzySet* set);
+/**
+ * Scores every candidate against `query` across the worker pool.
+ * @param[out] top      best matches first, at most `k` (<= FUZZY_TOP_K) of them
+ * @param[out] top_len  number of entries written to `top`
+ * @return the total number of matching candidates
+ */
+size_t fuzzy_search(FuzzySet* set, const char* query, FuzzyMatch* top, size_t k, size_t* top_len);
+/* Fills `positions` with the offsets of the matched characters; returns how many. */
+size_t fuzzy_positions(const string candidate, const char* query, size_t* positions, size_t max);
+void fuzzy_free(void);
+#endif /* __RICKSHELL_FUZZY_H__ */
@@ -0,0 +1,19 @@
+#ifndef __RICKSHELL_GITSTATUS_H__
+#define __RICKSHELL_GITSTATUS_H__
+#include <stdbool.h>
+#include "rstring.h"
+#define GITSTATUS_DEADLINE_MS 250
+#define GITSTATUS_MAX_REPOS 16
+
+/* Queues a background refresh of the repository containing `cwd`. */
+void git_status_request(const char* cwd);
+/* Appends the last known " (branch*)" text for `cwd`, if any, without blocking on the worker. */
+bool git_status_lookup(const char* cwd, StringBuilder* out);
+/* Becomes readable whenever the worker finishes a refresh. */
+int git_status_event_fd(void);
+/* True while a refresh is running or its result has not been collected. */
+bool git_status_pending(void);
+/* True once per published result that differs from the previous one. */
+bool git_status_changed(void);
+void git_status_free(void);
+#endif /* __RICKSHELL_GITSTATUS_H__ */
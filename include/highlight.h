@@ -0,0 +1,54 @@
+#ifndef __RICKSHELL_HIGHLIGHT_H__
+#define __RICKSHELL_HIGHLIGHT_H__
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "rstring.h"
+
+typedef enum {
+  LexToken_Space,
+  LexToken_Quoted,
+  LexToken_Pipe,
+  LexToken_Redirect,
+  LexToken_Operator,
+  LexToken_IoNumber,
+  LexToken_Word,
+  LexToken_Param,
+  LexToken_Other
+} LexTokenClass;
+
+typedef enum {
+  Highlight_Plain,
+  Highlight_Command,
+  Highlight_Missing,
+  Highlight_Assign,
+  Highlight_Quoted,
+  Highlight_Param,
+  Highlight_Redirect,
+  Highlight_Operator,
+  Highlight_Path,
+  Highlight_Control,
+  Highlight_Ghost
+} HighlightAttr;
+
+/* The scanner's DFA tables, exported from the user-code section of lexer.l
+ * so the highlighter walks the same automaton the parser does. States from
+ * `states` on are templates, and the last real state is the jam state. */
+typedef struct {
+  const int16_t* accept;
+  const unsigned char* ec;
+  const unsigned char* meta;
+  const int16_t* base;
+  const int16_t* def;
+  const int16_t* nxt;
+  const int16_t* chk;
+  int states;
+  int default_rule;
+} LexTables;
+
+extern const LexTables rick_lex_tables;
+bool command_exists(const string cmd);
+void highlight_line(const char* line, size_t len, unsigned char* attrs);
+const char* highlight_color(HighlightAttr attr);
+void highlight_reset(void);
+#endif /* __RICKSHELL_HIGHLIGHT_H__ */
@@ -0,0 +1,15 @@
+#ifndef __RICKSHELL_HISTINDEX_H__
+#define __RICKSHELL_HISTINDEX_H__
+#include <stdbool.h>
+#include <stddef.h>
+#include "rstring.h"
+
+/**
+ * Finds the newest history store entry below `before` that contains `query`.
+ * @param[in]  query
+ * @param[in]  before
+ * @param[out] found
+ */
+bool history_index_search(const string query, size_t before, size_t* found);
+void history_index_free(void);
+#endif /* __RICKSHELL_HISTINDEX_H__ */
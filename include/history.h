@@ -1,7 +1,11 @@
 #ifndef __RICKSHELL_HISTORY_H__
 #define __RICKSHELL_HISTORY_H__
 #include <stdbool.h>
+#include <stddef.h>
 #define DEFAULT_HISTFILE "~/.rickshell/.history"
+#define DEFAULT_HISTSIZE 1000
+#define HISTFILE_COMPACT_FACTOR 2
+#define HISTFILE_DUPLICATE_RATIO 4
 
 typedef struct {
   bool clear;
@@ -14,8 +18,15 @@ typedef struct {
   bool store;
   int delete_offset;
 } HistoryFlags;
-typedef int (*history_op_t)(const char*);
 
 void save_history(char* cmd);
 void reset_last_command(void);
+size_t history_size_limit(void);
+bool history_is_header(const char* line, size_t len);
+bool history_file_open(const char* path);
+bool history_file_append(const char* line);
+bool history_file_read_new(void);
+bool history_file_reload(void);
+bool history_file_compact(void);
+void history_file_close(void);
 #endif
\ No newline at end of file
@@ -0,0 +1,16 @@
+#ifndef __RICKSHELL_HISTSTORE_H__
+#define __RICKSHELL_HISTSTORE_H__
+#include <stdbool.h>
+#include <stddef.h>
+#include "rstring.h"
+
+bool history_store_open(const char* path);
+size_t history_store_load_recent(size_t max_entries);
+bool history_store_has_older(void);
+size_t history_store_file_count(void);
+size_t history_store_count(void);
+/* Returned slices point into the mapping or arena and are not NUL terminated. */
+string history_store_get(size_t index);
+string history_store_add(const char* line);
+void history_store_close(void);
+#endif /* __RICKSHELL_HISTSTORE_H__ */
@@ -1,10 +1,12 @@
 #ifndef __RICKSHELL_IO_H__
 #define __RICKSHELL_IO_H__
 #include <stdint.h>
+#include <stdbool.h>
 #include <stddef.h>
 #include "rstring.h"
 #include "result.h"
 
+ssize_t _write(int fd, const char *buf, size_t count);
 ssize_t _write_to_fd(int fd, string s);
 ssize_t _writeln_to_fd(int fd, string s);
 void print(string s);
@@ -21,9 +23,18 @@ typedef struct {
   size_t cursor_pos;
 } InputBuffer;
 
-string get_prompt(void);
 void enable_raw_mode(void);
 void disable_raw_mode(void);
+void rick__redisplay_init(void);
+void rick__redisplay_report(void);
 void rick__redisplay_function(void);
+int rick__clear_screen(int count, int key);
+int rick__history_search(int count, int key);
+int rick__accept_suggestion(int count, int key);
+int rick__bracketed_paste(int count, int key);
+int rick__pick_file(int count, int key);
+int rick__pick_history(int count, int key);
+void rick__event_loop_init(void);
+bool input_at_eof(void);
 string get_input(void);
 #endif /* __RICKSHELL_IO_H__ */
\ No newline at end of file
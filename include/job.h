@@ -1,5 +1,6 @@
 #ifndef __RICKSHELL_JOB_H__
 #define __RICKSHELL_JOB_H__
+#include <stdbool.h>
 #include <sys/types.h>
 #include "expr.h"
 #include "result.h"
@@ -32,6 +33,7 @@ void update_job_status(void);
 IntResult execute_background_job(CommandList* cmds, const string command_line, int* result);
 void print_jobs(void);
 void cleanup_jobs(void);
+bool job_status_changed(void);
 void print_job_status(void);
 void check_background_jobs(void);
 #endif /* __RICKSHELL_JOB_H__ */
\ No newline at end of file
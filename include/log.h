@@ -23,6 +23,8 @@ typedef struct {
   bool append_mode;
   bool file_output_only;
   const string log_format;
+  bool async_mode;
+  unsigned int async_queue_size;
 } LogConfig;
 
 void log_init(const LogConfig* config);
@@ -30,6 +32,7 @@ void log_shutdown(void);
 void log_set_level(LogLevel level);
 void log_set_color_output(bool enabled);
 void log_rotate(void);
+void log_flush(void);
 
 #define log_trace(...) log_write(LOG_LEVEL_TRACE, __FILE__, __LINE__, __func__, __VA_ARGS__)
 #define log_debug(...) log_write(LOG_LEVEL_DEBUG, __FILE__, __LINE__, __func__, __VA_ARGS__)
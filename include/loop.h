@@ -0,0 +1,33 @@
+#ifndef __RICKSHELL_LOOP_H__
+#define __RICKSHELL_LOOP_H__
+#include <stdbool.h>
+#define LOOP_MAX_WATCHES 16
+
+typedef void (*LoopHandler)(void* ctx);
+typedef void (*LoopSignalHandler)(int signo);
+
+/* Blocks SIGINT, SIGCHLD and SIGWINCH in every thread and routes them through
+ * a signalfd. Must run before any thread is created. */
+bool loop_init(void);
+/* Called when `fd` becomes readable; the handler does its own reading. */
+bool loop_watch(int fd, LoopHandler handler, void* ctx);
+void loop_unwatch(int fd);
+/* Counters are drained by the loop before the handler runs. */
+int loop_timer_new(LoopHandler handler, void* ctx);
+void loop_timer_arm(int fd, long long delay_ms);
+int loop_event_new(void);
+void loop_event_signal(int fd);
+void loop_event_drain(int fd);
+void loop_on_signal(int signo, LoopSignalHandler handler);
+/* While running commands the signals are unblocked again so that children
+ * start with a clean mask and SIGINT reaches only the foreground job. */
+void loop_enter(void);
+void loop_leave(void);
+/**
+ * Waits for one batch of events and dispatches them.
+ * @param timeout_ms  -1 to wait indefinitely
+ * @return the number of events handled, -1 on error
+ */
+int loop_run_once(int timeout_ms);
+void loop_free(void);
+#endif /* __RICKSHELL_LOOP_H__ */
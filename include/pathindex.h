@@ -0,0 +1,20 @@
+#ifndef __RICKSHELL_PATHINDEX_H__
+#define __RICKSHELL_PATHINDEX_H__
+#include <stdbool.h>
+#include "rstring.h"
+#define DEFAULT_PATH_CACHE "~/.rickshell/pathcache"
+
+/* Loads the cache and scans PATH on a thread; the first query waits for it. */
+void path_index_init(const char* cache_path);
+void path_index_refresh(void);
+/* For changes the directory mtime does not show, such as a chmod. */
+void path_index_rescan_dir(const char* dir, size_t len);
+bool path_index_contains(const string name);
+/* Sorted, de-duplicated executable names: returns how many start with `prefix`. */
+size_t path_index_find_prefix(const char* prefix, size_t len, size_t* first);
+const char* path_index_name_at(size_t pos);
+size_t path_index_count(void);
+/* Changes whenever the set of names was rebuilt. */
+unsigned long path_index_generation(void);
+void path_index_free(void);
+#endif /* __RICKSHELL_PATHINDEX_H__ */
@@ -0,0 +1,26 @@
+#ifndef __RICKSHELL_PICKER_H__
+#define __RICKSHELL_PICKER_H__
+#include <stdbool.h>
+#include <stddef.h>
+#include "fuzzy.h"
+#define PICKER_ROWS 10
+#define PICKER_MAX_FILES 2000000
+#define PICKER_ESC_TIMEOUT_MS 25
+#define PICKER_READ_CHUNK (64 * 1024)
+
+#define PICKER_WALK_FILES 1
+#define PICKER_WALK_DIRS 2
+
+/* History entries, newest first and without duplicates. */
+size_t picker_load_history(FuzzySet* set);
+/* Paths below `root`, breadth first, skipping hidden entries. `what` is a
+ * mask of PICKER_WALK_FILES and PICKER_WALK_DIRS. */
+size_t picker_load_files(FuzzySet* set, const char* root, int what);
+size_t picker_load_lines(FuzzySet* set, int fd);
+/**
+ * Runs the interactive picker on the controlling terminal, starting at the
+ * cursor's line; the area it used is cleared again before returning.
+ * @return the chosen candidate (caller frees), NULL when cancelled
+ */
+char* picker_run(FuzzySet* set, const char* query);
+#endif /* __RICKSHELL_PICKER_H__ */
@@ -0,0 +1,18 @@
+#ifndef __RICKSHELL_PREFETCH_H__
+#define __RICKSHELL_PREFETCH_H__
+#include <stddef.h>
+#define PREFETCH_DELAY_MS 120
+#define PREFETCH_REPEAT_SECONDS 60
+#define PREFETCH_RECENT 32
+#define PREFETCH_MAX_WORD 256
+#define PREFETCH_MAX_BYTES (512LL * 1024 * 1024)
+
+/* Off unless RICKSHELL_PREFETCH is set to something other than "0". Once the
+ * command word of `line` has stayed the same for PREFETCH_DELAY_MS, a worker
+ * asks the kernel to read its executable and ELF interpreter (or #! program)
+ * into the page cache. */
+void prefetch_command(const char* line, size_t len);
+/* Drops a request that has not started yet, e.g. once the line is accepted. */
+void prefetch_cancel(void);
+void prefetch_free(void);
+#endif /* __RICKSHELL_PREFETCH_H__ */
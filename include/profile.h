@@ -0,0 +1,18 @@
+#ifndef __RICKSHELL_PROFILE_H__
+#define __RICKSHELL_PROFILE_H__
+#include <stdbool.h>
+#define STARTUP_MAX_PHASES 32
+
+/* `rickshell --startup-profile`: each phase of init_rickshell() is timed from
+ * the end of the previous one, phases moved to a worker report their own
+ * duration, and the table goes to stderr when the shell exits. Everything is
+ * a no-op unless enabled. */
+void startup_profile_enable(void);
+bool startup_profile_enabled(void);
+long long startup_clock_ns(void);
+void startup_phase(const char* name);
+/* Safe to call from any thread. */
+void startup_background_phase(const char* name, long long start_ns);
+void startup_first_prompt(void);
+void startup_profile_report(void);
+#endif /* __RICKSHELL_PROFILE_H__ */
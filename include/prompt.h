@@ -0,0 +1,26 @@
+#ifndef __RICKSHELL_PROMPT_H__
+#define __RICKSHELL_PROMPT_H__
+#include <stdbool.h>
+#include <stddef.h>
+#include "rstring.h"
+#define DEFAULT_PS1 "\\[\\e[1;34m\\]\\u@\\H\\[\\e[1;30m\\]:\\[\\e[1;93m\\]\\w\\[\\e[1;35m\\]\\g\\[\\e[0m\\]$ "
+
+typedef enum {
+  Prompt_Cwd,
+  Prompt_Template,
+  Prompt_Vcs
+} PromptTrigger;
+
+/**
+ * @param[out] width  columns the prompt occupies on its last line, may be NULL
+ * @return the rendered prompt, owned by the prompt cache
+ */
+string prompt_render(size_t* width);
+void prompt_request_async(void);
+int prompt_async_fd(void);
+bool prompt_async_pending(void);
+bool prompt_async_changed(void);
+const char* prompt_cwd(void);
+void prompt_invalidate(PromptTrigger trigger);
+void prompt_free(void);
+#endif /* __RICKSHELL_PROMPT_H__ */
@@ -10,4 +10,6 @@ typedef enum   RedirectType RedirectType;
 
 void init_rickshell();
 void cleanup_rickshell();
+void init_rickshell_noninteractive();
+void cleanup_rickshell_noninteractive();
 #endif /* __RICKSHELL_RICK_H__ */
\ No newline at end of file
@@ -0,0 +1,51 @@
+#ifndef __RICKSHELL_SCRIPT_H__
+#define __RICKSHELL_SCRIPT_H__
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h>
+#include "rstring.h"
+#define SCRIPT_READ_CHUNK (64 * 1024)
+
+typedef struct {
+  char quote;
+  bool escaped;
+  bool comment;
+  bool word_start;
+} ScanState;
+
+/* Reads a script a chunk at a time and hands it out one statement at a time:
+ * a statement ends at a newline outside quotes, `\` joins lines and `#`
+ * starts a comment at the beginning of a word.
+ *
+ * Commands inherit stdin, so a script read from it must not hold on to input
+ * past the statement being run. A pipe is read a byte at a time; a seekable
+ * stdin is rewound to the end of the statement while it runs, and the
+ * buffered tail is only kept if nothing else read from it meanwhile. */
+typedef struct {
+  int fd;
+  char* buffer;
+  size_t start;
+  size_t len;
+  size_t capacity;
+  bool eof;
+  size_t line;
+  /* How far the statement starting at `start` has been scanned, so a read
+   * only scans the new bytes. */
+  size_t scanned;
+  ScanState scan;
+  size_t chunk;
+  bool rewind;
+  off_t rewound_to;
+} ScriptReader;
+
+void script_reader_init_fd(ScriptReader* reader, int fd);
+/* Reads from a copy of `text`, as for `rickshell -c`. */
+void script_reader_init_text(ScriptReader* reader, const char* text, size_t len);
+/**
+ * @param[out] statement  NUL-terminated and writable; valid until the next call
+ * @param[out] line       line number the statement starts on
+ * @return false once the input is exhausted or unreadable
+ */
+bool script_reader_next(ScriptReader* reader, string* statement, size_t* line);
+void script_reader_free(ScriptReader* reader);
+#endif /* __RICKSHELL_SCRIPT_H__ */
@@ -0,0 +1,11 @@
+#ifndef __RICKSHELL_SUGGEST_H__
+#define __RICKSHELL_SUGGEST_H__
+#include "rstring.h"
+
+void suggest_init(void);
+void suggest_add(const string line);
+void suggest_set_directory(const char* cwd);
+/* Returns the best history entry starting with `prefix`, or _SLIT0. */
+string suggest_lookup(const string prefix);
+void suggest_free(void);
+#endif /* __RICKSHELL_SUGGEST_H__ */
@@ -0,0 +1,31 @@
+#ifndef __RICKSHELL_TRACE_H__
+#define __RICKSHELL_TRACE_H__
+#include <stdint.h>
+
+/**
+ * Phase tracing, built only with -D_HYUNSEO_DEV_TRACE_SPANS (make TRACE=1).
+ * At runtime it stays off unless RICKSHELL_TRACE names an output file.
+ */
+#if defined(_HYUNSEO_DEV_TRACE_SPANS)
+void trace_init(void);
+void trace_flush(void);
+void trace_shutdown(void);
+uint64_t trace_now(void);
+void trace_span(const char* name, uint64_t start_ns, uint64_t end_ns);
+void trace_instant(const char* name);
+
+#define TRACE_INIT()              trace_init()
+#define TRACE_FLUSH()             trace_flush()
+#define TRACE_SHUTDOWN()          trace_shutdown()
+#define TRACE_BEGIN(var)          uint64_t var = trace_now()
+#define TRACE_END(var, name)      trace_span(name, var, trace_now())
+#define TRACE_INSTANT(name)       trace_instant(name)
+#else
+#define TRACE_INIT()              ((void)0)
+#define TRACE_FLUSH()             ((void)0)
+#define TRACE_SHUTDOWN()          ((void)0)
+#define TRACE_BEGIN(var)          ((void)0)
+#define TRACE_END(var, name)      ((void)0)
+#define TRACE_INSTANT(name)       ((void)0)
+#endif
+#endif /* __RICKSHELL_TRACE_H__ */
@@ -43,6 +43,11 @@ typedef struct {
   int array_capacity;
 } Variable;
 
+typedef enum {
+  VarDump_Declare,
+  VarDump_Assign,
+} VarDumpStyle;
+
 typedef struct {
   Variable* variables;
   int size;
@@ -78,4 +83,7 @@ void vfree_va_value(void* value);
 void free_variable(Variable* var);
 void cleanup_variables();
 string expand_variables(VariableTable* table, const string input);
+void dump_variable(StringBuilder* sb, const Variable* var, VarDumpStyle style);
+bool dump_variables(VariableTable* table, va_flag_t filter, VarDumpStyle style, int fd);
+bool save_variables(VariableTable* table, const char* path);
 #endif /* __RICKSHELL_VARIABLE_H__ */
\ No newline at end of file
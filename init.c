@@ -1,6 +1,5 @@
 #define _XOPEN_SOURCE 700
 #include <locale.h>
-#include <signal.h>
 #include <readline/readline.h>
 #include <readline/history.h>
 #include "variable.h"
@@ -9,35 +8,27 @@
 #include "io.h"
 #include "memory.h"
 #include "history.h"
+#include "histstore.h"
+#include "histindex.h"
+#include "suggest.h"
+#include "pathindex.h"
+#include "trace.h"
+#include "prompt.h"
+#include "complete.h"
+#include "correct.h"
+#include "fuzzy.h"
+#include "prefetch.h"
+#include "loop.h"
+#include "profile.h"
 
-extern volatile sig_atomic_t keep_running;
 static char* last_cmd = NULL;
 
-static void handle_sigint(int sig) {
-  (void)sig;
-  keep_running = 0;
-  println(_SLIT0);
-  string prompt = get_prompt();
-  print(prompt);
-  string__free(prompt);
-}
-
-static int setup_signal_handler(void) {
-  struct sigaction sa = {0};
-  sa.sa_handler = handle_sigint;
-  sa.sa_flags = SA_RESTART;
-  
-  if (sigaction(SIGINT, &sa, NULL) == -1) {
-    perror("Error setting up signal handler");
-    return -1;
-  }
-  return 0;
-}
-
 void initialize_history() {
-  char* path = expand_home_directory(DEFAULT_HISTFILE);
-  read_history(path);
-  rfree(path);
+  history_comment_char = '#';
+  history_store_open(DEFAULT_HISTFILE);
+  history_store_load_recent(history_size_limit());
+  history_file_open(DEFAULT_HISTFILE);
+  suggest_init();
 }
 
 char* get_last_command() {
@@ -58,23 +49,44 @@ void reset_last_command() {
 
 void save_history(char* cmd) {
   if (!cmd || (last_cmd && strcmp(cmd, last_cmd) == 0)) return;
-  char* path = expand_home_directory(DEFAULT_HISTFILE);
-  write_history(path);
-  rfree(path);
   rfree(last_cmd);
   last_cmd = rstrdup(cmd);
-  add_history(cmd);
+  history_file_append(cmd);
 }
 
 void init_rickshell() {
   setlocale(LC_ALL, "");
-  if (setup_signal_handler() == -1) _exit(1);
+  startup_phase("setlocale");
+  if (!loop_init()) _exit(1);
+  startup_phase("loop_init");
+  TRACE_INIT();
   ensure_directory_exist("~/.rickshell");
+  startup_phase("ensure_directory_exist");
   parse_path();
+  startup_phase("parse_path");
+  path_index_init(DEFAULT_PATH_CACHE);
+  startup_phase("path index");
+  rick__redisplay_init();
+  rick__event_loop_init();
   rl_redisplay_function = rick__redisplay_function;
+  rl_catch_signals = 0;
+  rl_catch_sigwinch = 0;
+  rl_attempted_completion_function = rick__complete;
+  rl_bind_key(CTRL('r'), rick__history_search);
+  rl_bind_key(CTRL('f'), rick__accept_suggestion);
+  rl_bind_key(CTRL('l'), rick__clear_screen);
+  rl_bind_keyseq("\\e[C", rick__accept_suggestion);
+  rl_bind_keyseq("\\eOC", rick__accept_suggestion);
+  rl_bind_keyseq("\\e[200~", rick__bracketed_paste);
+  rl_bind_key(CTRL('t'), rick__pick_file);
+  rl_bind_keyseq("\\er", rick__pick_history);
+  startup_phase("readline hooks");
   init_variables();
+  startup_phase("init_variables");
   initialize_history();
+  startup_phase("history load");
   last_cmd = get_last_command();
+  startup_phase("get_last_command");
   LogConfig config = {
     .name = _SLIT("rickshell"),
     .level = LOG_LEVEL_INFO,
@@ -84,16 +96,50 @@ void init_rickshell() {
     .max_backup_files = 10,
     .append_mode = true,
     .file_output_only = true,
-    .log_format = _SLIT("[%Y-%M-%d %H:%M:%S] [%L] [%p] (%a) %f:%l (%n): %m")
+    .log_format = _SLIT("[%Y-%M-%d %H:%M:%S] [%L] [%p] (%a) %f:%l (%n): %m"),
+    .async_mode = true,
+    .async_queue_size = 1024
   };
   log_init(&config);
+  startup_phase("log_init");
+}
+
+/* Scripts and `-c` get no line editor, history, prompt or log. */
+void init_rickshell_noninteractive() {
+  setlocale(LC_ALL, "");
+  TRACE_INIT();
+  parse_path();
+  path_index_init(DEFAULT_PATH_CACHE);
+  init_variables();
+}
+
+void cleanup_rickshell_noninteractive() {
+  fuzzy_free();
+  correct_free();
+  path_index_free();
+  cleanup_variables();
+  TRACE_SHUTDOWN();
 }
 
 void cleanup_rickshell() {
+  history_file_close();
+  history_index_free();
+  suggest_free();
+  complete_free();
+  fuzzy_free();
+  correct_free();
+  prefetch_free();
+  path_index_free();
+  prompt_free();
+  loop_free();
+  history_store_close();
   cleanup_variables();
+  rick__redisplay_report();
   log_info("Shell exited");
   log_shutdown();
   rfree(last_cmd);
   rl_clear_history();
   rl_cleanup_after_signal();
+  TRACE_SHUTDOWN();
+  startup_profile_report();
 }
\ No newline at end of file
@@ -1,5 +1,5 @@
 #define _XOPEN_SOURCE 700
-#define _POSIX_C_SOURCE 1
+#define _POSIX_C_SOURCE 200809L
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -11,7 +11,9 @@
 #include <errno.h>
 #include <dirent.h>
 #include <sys/stat.h>
-#include <pwd.h>
+#include <poll.h>
+#include <time.h>
+#include <signal.h>
 #include <readline/readline.h>
 #include "color.h"
 #include "error.h"
@@ -21,183 +23,637 @@
 #include "builtin.h"
 #include "file.h"
 #include "io.h"
+#include "trace.h"
+#include "histstore.h"
+#include "histindex.h"
+#include "suggest.h"
+#include "pathindex.h"
+#include "highlight.h"
+#include "prompt.h"
+#include "complete.h"
+#include "fuzzy.h"
+#include "picker.h"
+#include "prefetch.h"
+#include "loop.h"
+#include "job.h"
+#include "log.h"
+#include "profile.h"
 
 #define INITIAL_BUFFER_SIZE 256
 #define CTRL_KEY(k) ((k) & 0x1f)
+#define REDISPLAY_FRAME_DEADLINE_NS (16 * 1000000LL)
+#define PASTE_READ_CHUNK (64 * 1024)
+#define PASTE_TIMEOUT_MS 500
+#define PASTE_END "\033[201~"
+#define PASTE_END_LEN 6
 
-extern char *path_dirs[MAX_PATH_DIRS];
-extern int path_dir_count;
 string prompt = _SLIT0;
 size_t prompt_len = 0;
+static size_t prompt_last_line = 0;
+static bool prompt_shown = false;
 
-static int is_command_char(char c) {
-  return isalnum(c) || c == '_' || c == '-' || c == '.';
+extern volatile int last_status;
+
+/* State of the line being read through readline's callback interface; the
+ * event loop runs until accept_line() stores a result. */
+static struct {
+  bool active;
+  bool done;
+  bool eof;
+  char* line;
+  int redisplay_timer;
+  bool frame_deferred;
+  unsigned long bytes_read;
+  unsigned long skipped_at;
+} reader = {.redisplay_timer = -1};
+
+/* Ctrl-R search in progress. While it is active the terminal handler feeds
+ * keys here instead of to readline, so the search runs inside the event loop
+ * like the rest of line editing. */
+static struct {
+  bool active;
+  StringBuilder query;
+  string match;
+  size_t match_id;
+  bool failed;
+} search;
+
+static void render_history_search(void);
+
+typedef struct {
+  char* text;
+  unsigned char* attrs;
+  size_t len;
+  size_t capacity;
+} ScreenLine;
+
+/* What is currently drawn after the prompt, so a redisplay can emit only the
+ * part of the line that changed. */
+static ScreenLine drawn, pending;
+static bool drawn_valid = false;
+static size_t drawn_cursor = 0;
+static bool sync_output = false;
+static long long last_frame_ns = 0;
+static struct {
+  size_t frames;
+  size_t skipped;
+  size_t bytes;
+  size_t writes;
+} redisplay_stats;
+
+static void screen_reserve(ScreenLine* sl, size_t capacity) {
+  if (capacity <= sl->capacity) return;
+  sl->capacity = capacity * 2;
+  sl->text = rrealloc(sl->text, sl->capacity);
+  sl->attrs = rrealloc(sl->attrs, sl->capacity);
+}
+
+static void screen_put(ScreenLine* sl, const char* text, size_t len, HighlightAttr attr) {
+  screen_reserve(sl, sl->len + len);
+  memcpy(sl->text + sl->len, text, len);
+  memset(sl->attrs + sl->len, attr, len);
+  sl->len += len;
+}
+
+static void screen_put_highlighted(ScreenLine* sl, const char* text, size_t len) {
+  screen_reserve(sl, sl->len + len);
+  memcpy(sl->text + sl->len, text, len);
+  highlight_line(text, len, sl->attrs + sl->len);
+  /* Pasted newlines and tabs are drawn as caret letters so that every byte
+   * still occupies exactly one cell on the single prompt row. */
+  for (size_t i = 0; i < len; i++) {
+    if ((unsigned char)text[i] < 0x20) {
+      sl->text[sl->len + i] = (char)(text[i] + '@');
+      sl->attrs[sl->len + i] = Highlight_Control;
+    }
+  }
+  sl->len += len;
+}
+
+static size_t screen_column(const char* text, size_t len) {
+  size_t col = 0;
+  for (size_t i = 0; i < len; i++)
+    if (((unsigned char)text[i] & 0xC0) != 0x80) col++;
+  return col;
+}
+
+static void append_cursor_column(StringBuilder* out, size_t col) {
+  string_builder__append_cstr(out, "\033[");
+  string_builder__append_long_long(out, (long long)col + 1);
+  string_builder__append_char(out, 'G');
+}
+
+
+static long long monotonic_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/* Keys that are already queued will call us again right away, so drawing
+ * now would only produce a frame the user never sees. */
+static bool typeahead_pending(void) {
+  if (rl_pending_input != 0) return true;
+  struct pollfd pfd = {.fd = rl_instream != NULL ? fileno(rl_instream) : STDIN_FILENO, .events = POLLIN};
+  return poll(&pfd, 1, 0) > 0 && (pfd.revents & POLLIN);
+}
+
+void rick__redisplay_report(void) {
+  if (redisplay_stats.frames == 0) return;
+  log_info("redisplay: %zu frames, %zu skipped, %.1f bytes/frame, %.2f writes/frame",
+    redisplay_stats.frames,
+    redisplay_stats.skipped,
+    (double)redisplay_stats.bytes / (double)redisplay_stats.frames,
+    (double)redisplay_stats.writes / (double)redisplay_stats.frames);
+}
+
+void rick__redisplay_function(void) {
+  char *line = rl_line_buffer;
+  size_t len = (size_t)rl_end;
+  size_t cursor = (size_t)rl_point;
+
+  if (search.active) {
+    render_history_search();
+    return;
+  }
+
+  /* Between the bytes of a key sequence nothing on the line has changed yet,
+   * and readline may ask again for a frame that was just skipped. */
+  if (!rl_done && (RL_ISSTATE(RL_STATE_MULTIKEY) || (reader.frame_deferred && reader.skipped_at == reader.bytes_read)))
+    return;
+
+  long long now = monotonic_ns();
+  if (!rl_done && now - last_frame_ns < REDISPLAY_FRAME_DEADLINE_NS && typeahead_pending()) {
+    redisplay_stats.skipped++;
+    reader.skipped_at = reader.bytes_read;
+    if (!reader.frame_deferred) {
+      loop_timer_arm(reader.redisplay_timer, REDISPLAY_FRAME_DEADLINE_NS / 1000000);
+      reader.frame_deferred = true;
+    }
+    return;
+  }
+
+  pending.len = 0;
+  screen_put_highlighted(&pending, line, len);
+
+  if (!rl_done) prefetch_command(line, len);
+
+  if (!rl_done && len > 0 && cursor == len) {
+    string suggestion = suggest_lookup((string){.str = line, .len = len, .is_lit = 1});
+    if (suggestion.len > len)
+      screen_put(&pending, suggestion.str + len, suggestion.len - len, Highlight_Ghost);
+  }
+
+  size_t first = 0;
+  if (drawn_valid) {
+    size_t common = drawn.len < pending.len ? drawn.len : pending.len;
+    while (first < common && drawn.text[first] == pending.text[first] && drawn.attrs[first] == pending.attrs[first])
+      first++;
+    while (first > 0 && ((unsigned char)pending.text[first] & 0xC0) == 0x80)
+      first--;
+    if (first == drawn.len && first == pending.len && cursor == drawn_cursor) return;
+  }
+
+  StringBuilder out = string_builder__with_capacity(prompt.len + pending.len * 2 + 64);
+  if (sync_output) string_builder__append_cstr(&out, "\033[?2026h");
+  if (!drawn_valid) {
+    size_t skip = prompt_shown ? prompt_last_line : 0;
+    string_builder__append_cstr(&out, "\r\033[K");
+    string_builder__append(&out, (string){.str = prompt.str + skip, .len = prompt.len - skip, .is_lit = 1});
+    prompt_shown = true;
+  } else if (first < pending.len || first < drawn.len) {
+    append_cursor_column(&out, prompt_len + screen_column(pending.text, first));
+  }
+
+  HighlightAttr attr = Highlight_Plain;
+  for (size_t i = first; i < pending.len;) {
+    size_t run = i;
+    while (run < pending.len && pending.attrs[run] == pending.attrs[i]) run++;
+    if ((HighlightAttr)pending.attrs[i] != attr) {
+      attr = (HighlightAttr)pending.attrs[i];
+      string_builder__append_cstr(&out, highlight_color(attr));
+    }
+    string_builder__append(&out, (string){.str = pending.text + i, .len = run - i, .is_lit = 1});
+    i = run;
+  }
+  if (attr != Highlight_Plain) string_builder__append_cstr(&out, ANSI_COLOR_RESET);
+  if (drawn_valid && drawn.len > pending.len) string_builder__append_cstr(&out, "\033[K");
+
+  append_cursor_column(&out, prompt_len + screen_column(pending.text, cursor));
+  if (sync_output) string_builder__append_cstr(&out, "\033[?2026l");
+
+  fflush(stdout);
+  _write(STDOUT_FILENO, out.buffer, out.len);
+  redisplay_stats.frames++;
+  redisplay_stats.bytes += out.len;
+  redisplay_stats.writes++;
+  string_builder__free(&out);
+
+  ScreenLine swap = drawn;
+  drawn = pending;
+  pending = swap;
+  drawn_valid = true;
+  drawn_cursor = cursor;
+  last_frame_ns = now;
+}
+
+static void display_match_list(char** matches, int num_matches, int max_length) {
+  rl_display_match_list(matches, num_matches, max_length);
+  drawn_valid = false;
+  rl_forced_update_display();
+}
+
+void rick__redisplay_init(void) {
+  const char* term = getenv("TERM");
+  sync_output = term != NULL && strcmp(term, "dumb") != 0 && strcmp(term, "linux") != 0;
+  rl_completion_display_matches_hook = display_match_list;
 }
 
-static int command_exists(const string cmd) {
-  if (get_builtin_func(cmd) != NULL) {
-    return 1;
+int rick__clear_screen(int count, int key) {
+  drawn_valid = false;
+  prompt_shown = false;
+  return rl_clear_screen(count, key);
+}
+
+int rick__accept_suggestion(int count, int key) {
+  if (rl_point == rl_end && rl_end > 0) {
+    string suggestion = suggest_lookup((string){.str = rl_line_buffer, .len = (size_t)rl_end, .is_lit = 1});
+    if (suggestion.len > (size_t)rl_end) {
+      char* rest = strndup(suggestion.str + rl_end, suggestion.len - (size_t)rl_end);
+      rl_insert_text(rest);
+      free(rest);
+      return 0;
+    }
   }
+  return rl_forward_char(count, key);
+}
 
-  StringBuilder s = string_builder__new();
-  struct stat st;
+static char* find_paste_end(char* buf, size_t from, size_t len) {
+  for (size_t i = from; i + PASTE_END_LEN <= len; i++)
+    if (buf[i] == '\033' && memcmp(buf + i, PASTE_END, PASTE_END_LEN) == 0) return buf + i;
+  return NULL;
+}
 
-  for (int i = 0; i < path_dir_count; i++) {
-    string_builder__append_cstr(&s, path_dirs[i]);
-    string_builder__append_char(&s, '/');
-    string_builder__append(&s, cmd);
-    string full_path = string_builder__to_string(&s);
-    string_builder__free(&s);
+/* Bound to the bracketed-paste prefix. Readline would feed the payload back
+ * through rl_read_key() one byte at a time; read it in bulk instead and hand
+ * it to rl_insert_text() as a single edit, so newlines in the paste become
+ * part of the line rather than accepting it. */
+int rick__bracketed_paste(int count, int key) {
+  (void)count;
+  (void)key;
+  int fd = rl_instream != NULL ? fileno(rl_instream) : STDIN_FILENO;
+  StringBuilder paste = string_builder__with_capacity(PASTE_READ_CHUNK);
+  char* end = NULL;
 
-    if (stat(full_path.str, &st) == 0 && (st.st_mode & S_IXUSR)) {
-      string__free(full_path);
-      string_builder__free(&s);
-      return 1;
+  while (end == NULL) {
+    struct pollfd pfd = {.fd = fd, .events = POLLIN};
+    int ready = poll(&pfd, 1, PASTE_TIMEOUT_MS);
+    if (ready < 0 && errno == EINTR) continue;
+    if (ready <= 0) break;
+    if (paste.capacity - paste.len < PASTE_READ_CHUNK) {
+      paste.capacity = paste.capacity * 2 + PASTE_READ_CHUNK;
+      paste.buffer = rrealloc(paste.buffer, paste.capacity);
     }
-    string__free(full_path);
-    string_builder__free(&s);
-    s = string_builder__new();
+    ssize_t n = read(fd, paste.buffer + paste.len, PASTE_READ_CHUNK);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) break;
+    size_t from = paste.len >= PASTE_END_LEN ? paste.len - (PASTE_END_LEN - 1) : 0;
+    paste.len += (size_t)n;
+    end = find_paste_end(paste.buffer, from, paste.len);
   }
-  string_builder__free(&s);
 
+  size_t len = paste.len;
+  if (end != NULL) {
+    len = (size_t)(end - paste.buffer);
+    for (char* rest = end + PASTE_END_LEN; rest < paste.buffer + paste.len; rest++)
+      rl_stuff_char((unsigned char)*rest);
+  }
+
+  size_t out = 0;
+  for (size_t i = 0; i < len; i++) {
+    char c = paste.buffer[i];
+    if (c == '\0') continue;
+    if (c == '\r') {
+      if (i + 1 < len && paste.buffer[i + 1] == '\n') continue;
+      c = '\n';
+    }
+    paste.buffer[out++] = c;
+  }
+  paste.buffer[out] = '\0';
+
+  TRACE_BEGIN(paste_start);
+  if (out > 0) rl_insert_text(paste.buffer);
+  TRACE_END(paste_start, "paste");
+  string_builder__free(&paste);
   return 0;
 }
 
-void rick__redisplay_function(void) {
-  char *line = rl_line_buffer;
-  int cursor = rl_point;
-  size_t len = strlen(line);
-    
-  char *cmd = NULL;
-  size_t cmd_len = 0;
-  while (cmd_len < len && is_command_char(line[cmd_len]))
-    cmd_len++;
-    
-  if (cmd_len > 0)
-    cmd = strndup(line, cmd_len);
-
-  printf("\r\033[K%s", prompt.str);
-  
-  if (cmd) {
-    string scmd = string__new(cmd);
-    const char* color = command_exists(scmd) ? ANSI_COLOR_GREEN : ANSI_COLOR_RED;
-    printf("%s%s%s", color, cmd, ANSI_COLOR_RESET);
-    free(cmd);
-    string__free(scmd);
-  }
-  
-  if (cmd_len < len)
-    printf("%s", line + cmd_len);
-  
-  printf("\r");
-  for (size_t i = 0; i < prompt_len + (size_t)cursor; i++)
-    printf("\033[C");
+static bool history_search_older(const string query, size_t before, const string skip, size_t* found) {
+  while (history_index_search(query, before, found)) {
+    if (!string__equals(history_store_get(*found), skip)) return true;
+    before = *found;
+  }
+  return false;
+}
+
+static void render_history_search(void) {
+  StringBuilder out = string_builder__with_capacity(search.query.len + search.match.len + 48);
+  string_builder__append_cstr(&out, search.failed ? "\r\033[K(failed reverse-i-search)`" : "\r\033[K(reverse-i-search)`");
+  string_builder__append(&out, (string){.str = search.query.buffer, .len = search.query.len, .is_lit = 1});
+  string_builder__append_cstr(&out, "': ");
+  string_builder__append(&out, search.match);
   fflush(stdout);
+  _write(STDOUT_FILENO, out.buffer, out.len);
+  string_builder__free(&out);
 }
 
-string get_input(void) {
-  prompt = get_prompt();
-  char* raw_input = readline(prompt.str);
-  string input = string__new(raw_input);
-  free(raw_input);
-  string__free(prompt);
-  prompt = _SLIT0;
-  return input;
+static void accept_history_match(const string match) {
+  char* line = strndup(match.str, match.len);
+  rl_replace_line(line, 0);
+  rl_point = rl_end;
+  free(line);
+}
+
+static void end_history_search(void) {
+  if (!search.active) return;
+  string_builder__free(&search.query);
+  search.active = false;
+  search.match = _SLIT0;
+  drawn_valid = false;
 }
 
-static char* get_hostname(void) {
-  char* hostname = NULL;
-  long host_name_max = sysconf(_SC_HOST_NAME_MAX);
-  if (host_name_max == -1)
-    host_name_max = _POSIX_HOST_NAME_MAX;
-  hostname = rmalloc((size_t)host_name_max + 1);
-  if (hostname == NULL) {
-    perror("Error allocating memory");
-    return NULL;
+/* Any key the search does not handle ends it on the current match and is then
+ * run as an ordinary readline key, so Enter accepts the line. */
+static void history_search_key(int c) {
+  string q = {.str = search.query.buffer, .len = search.query.len, .is_lit = 1};
+  size_t found;
+
+  if (c == CTRL_KEY('r')) {
+    if (search.query.len == 0) return;
+    if (history_search_older(q, search.match_id, search.match, &found)) {
+      search.match_id = found;
+      search.match = history_store_get(found);
+      search.failed = false;
+    } else {
+      search.failed = true;
+    }
+  } else if (c == CTRL_KEY('g')) {
+    end_history_search();
+    (*rl_redisplay_function)();
+    return;
+  } else if (c == 127 || c == CTRL_KEY('h')) {
+    if (search.query.len > 0) search.query.len--;
+    q.len = search.query.len;
+    search.match_id = history_store_count();
+    search.match = _SLIT0;
+    search.failed = false;
+    if (search.query.len > 0 && history_index_search(q, search.match_id, &found)) {
+      search.match_id = found;
+      search.match = history_store_get(found);
+    }
+  } else if (c >= 0 && c < 256 && isprint(c)) {
+    string_builder__append_char(&search.query, (char)c);
+    q = (string){.str = search.query.buffer, .len = search.query.len, .is_lit = 1};
+    size_t before = search.match.len > 0 ? search.match_id + 1 : history_store_count();
+    if (history_index_search(q, before, &found)) {
+      search.match_id = found;
+      search.match = history_store_get(found);
+      search.failed = false;
+    } else {
+      search.failed = true;
+    }
+  } else {
+    if (search.match.len > 0) accept_history_match(search.match);
+    end_history_search();
+    rl_execute_next(c);
+    rl_callback_read_char();
+    return;
   }
+  render_history_search();
+}
+
+int rick__history_search(int count, int key) {
+  (void)count;
+  (void)key;
+  search.active = true;
+  search.query = string_builder__new();
+  search.match = _SLIT0;
+  search.match_id = history_store_count();
+  search.failed = false;
+  render_history_search();
+  return 0;
+}
+
+static void load_prompt(void) {
+  prompt = prompt_render(&prompt_len);
+  prompt_last_line = prompt.len;
+  while (prompt_last_line > 0 && prompt.str[prompt_last_line - 1] != '\n') prompt_last_line--;
+}
 
-  if (gethostname(hostname, (size_t)host_name_max + 1) != 0) {
-    perror("Error getting hostname");
-    rfree(hostname);
-    return NULL;
+static void redraw_line(void) {
+  drawn_valid = false;
+  (*rl_redisplay_function)();
+}
+
+/* Erases the prompt and the line so that output can be printed in their
+ * place; the next redisplay draws both again from scratch. */
+static void clear_line_area(void) {
+  size_t rows = 0;
+  for (size_t i = 0; i < prompt_last_line; i++)
+    if (prompt.str[i] == '\n') rows++;
+  StringBuilder out = string_builder__new();
+  if (rows > 0) {
+    string_builder__append_cstr(&out, "\033[");
+    string_builder__append_long_long(&out, (long long)rows);
+    string_builder__append_char(&out, 'A');
   }
+  string_builder__append_cstr(&out, "\r\033[J");
+  _write(STDOUT_FILENO, out.buffer, out.len);
+  string_builder__free(&out);
+  prompt_shown = false;
+  drawn_valid = false;
+}
 
-  char* copy = strdup(hostname);
-  rfree(hostname);
-  return copy;
+static void insert_escaped(const char* text) {
+  StringBuilder out = string_builder__new();
+  for (const char* p = text; *p != '\0'; p++) {
+    if (strchr(" \t\n\\'\"`$&|;<>()[]{}*?!#~", *p) != NULL) string_builder__append_char(&out, '\\');
+    string_builder__append_char(&out, *p);
+  }
+  rl_insert_text(out.buffer);
+  string_builder__free(&out);
 }
 
-static char* get_username(void) {
-  struct passwd *pw = getpwuid(getuid());
-  if (pw == NULL) {
-    perror("Failed to get username");
-    return NULL;
+/* The pickers draw over the prompt and the line, which are redrawn from
+ * scratch once the picker has cleared its area again. */
+int rick__pick_file(int count, int key) {
+  (void)count;
+  (void)key;
+  int start = rl_point;
+  while (start > 0 && !isspace((unsigned char)rl_line_buffer[start - 1])) start--;
+  char* query = strndup(rl_line_buffer + start, (size_t)(rl_point - start));
+
+  FuzzySet set;
+  fuzzy_set_init(&set);
+  picker_load_files(&set, ".", PICKER_WALK_FILES | PICKER_WALK_DIRS);
+  clear_line_area();
+  char* choice = picker_run(&set, query);
+  fuzzy_set_free(&set);
+  free(query);
+
+  if (choice != NULL) {
+    rl_delete_text(start, rl_point);
+    rl_point = start;
+    insert_escaped(choice);
+    rfree(choice);
   }
+  redraw_line();
+  return 0;
+}
 
-  char* username = strdup(pw->pw_name);
-  if (username == NULL) {
-    perror("Failed to allocate memory for username");
-    return NULL;
+int rick__pick_history(int count, int key) {
+  (void)count;
+  (void)key;
+  char* query = strndup(rl_line_buffer, (size_t)rl_end);
+
+  FuzzySet set;
+  fuzzy_set_init(&set);
+  picker_load_history(&set);
+  clear_line_area();
+  char* choice = picker_run(&set, query);
+  fuzzy_set_free(&set);
+  free(query);
+
+  if (choice != NULL) {
+    rl_replace_line(choice, 0);
+    rl_point = rl_end;
+    rfree(choice);
   }
+  redraw_line();
+  return 0;
+}
+
+static void accept_line(char* line) {
+  prefetch_cancel();
+  reader.line = line;
+  reader.eof = line == NULL;
+  reader.done = true;
+  rl_callback_handler_remove();
+}
+
+static int counting_getc(FILE* stream) {
+  reader.bytes_read++;
+  return rl_getc(stream);
+}
 
-  return username;
+static void read_terminal(void* ctx) {
+  (void)ctx;
+  if (search.active) history_search_key(rl_read_key());
+  else rl_callback_read_char();
 }
 
-static char* get_current_directory() {
-  char* cwd = getcwd(NULL, 0);
-  if (cwd == NULL) {
-    perror("Error getting current directory");
-    return NULL;
+static void refresh_async_prompt(void* ctx) {
+  (void)ctx;
+  loop_event_drain(prompt_async_fd());
+  if (prompt_async_changed() && reader.active) {
+    load_prompt();
+    redraw_line();
   }
+}
+
+static void deliver_completions(void* ctx) {
+  (void)ctx;
+  if (reader.active && !search.active) complete_deliver();
+  else loop_event_drain(complete_event_fd());
+}
 
-  const char* home = getenv("HOME");
-  if (home != NULL && strncmp(cwd, home, strlen(home)) == 0) {
-    size_t home_len = strlen(home);
-    size_t cwd_len = strlen(cwd);
-    char* result = malloc(cwd_len - home_len + 2); // +2 for '~' and '\0'
+static void finish_skipped_frame(void* ctx) {
+  (void)ctx;
+  reader.frame_deferred = false;
+  if (reader.active) (*rl_redisplay_function)();
+}
 
-    if (result == NULL) {
-      free(cwd);
-      return NULL;
+static void interrupt_line(int signo) {
+  (void)signo;
+  if (!reader.active) return;
+  if (search.active) {
+    end_history_search();
+    redraw_line();
+  }
+  StringBuilder out = string_builder__new();
+  append_cursor_column(&out, prompt_len + screen_column(drawn.text, drawn.len));
+  string_builder__append_cstr(&out, "^C\r\n");
+  _write(STDOUT_FILENO, out.buffer, out.len);
+  string_builder__free(&out);
+
+  rl_free_line_state();
+  rl_callback_sigcleanup();
+  rl_replace_line("", 1);
+  rl_point = rl_end = rl_mark = 0;
+  last_status = 130;
+  highlight_reset();
+  prompt_shown = false;
+  redraw_line();
+}
+
+static void resize_terminal(int signo) {
+  (void)signo;
+  rl_resize_terminal();
+  if (reader.active) redraw_line();
+}
+
+static void report_jobs(int signo) {
+  (void)signo;
+  if (!reader.active || !job_status_changed()) return;
+  clear_line_area();
+  print_job_status();
+  redraw_line();
+}
+
+void rick__event_loop_init(void) {
+  loop_watch(rl_instream != NULL ? fileno(rl_instream) : STDIN_FILENO, read_terminal, NULL);
+  loop_watch(prompt_async_fd(), refresh_async_prompt, NULL);
+  loop_watch(complete_event_fd(), deliver_completions, NULL);
+  reader.redisplay_timer = loop_timer_new(finish_skipped_frame, NULL);
+  rl_getc_function = counting_getc;
+  loop_on_signal(SIGINT, interrupt_line);
+  loop_on_signal(SIGWINCH, resize_terminal);
+  loop_on_signal(SIGCHLD, report_jobs);
+}
+
+bool input_at_eof(void) {
+  return reader.eof;
+}
+
+string get_input(void) {
+  load_prompt();
+  prompt_request_async();
+  prompt_shown = false;
+  drawn_valid = false;
+  highlight_reset();
+  path_index_refresh();
+  suggest_set_directory(prompt_cwd());
+  TRACE_BEGIN(readline_start);
+  loop_enter();
+  reader.active = true;
+  reader.done = false;
+  reader.eof = false;
+  reader.line = NULL;
+  rl_callback_handler_install(prompt.str, accept_line);
+  startup_first_prompt();
+  while (!reader.done) {
+    if (loop_run_once(-1) < 0) {
+      rl_callback_handler_remove();
+      reader.eof = true;
+      break;
     }
-      
-    result[0] = '~';
-    strcpy(result + 1, cwd + home_len);
-    free(cwd);
-    return result;
-  }
-
-  return cwd;
-}
-
-string get_prompt(void) {
-  char* hostname = get_hostname();
-  char* username = get_username();
-  char* cwd = get_current_directory();
-
-  prompt_len = 0;
-  StringBuilder s = string_builder__new();
-  string_builder__append_cstr(&s, ANSI_COLOR_BOLD_BLUE);
-  string_builder__append_cstr(&s, (username != NULL) ? username : "daniel");
-  string_builder__append_char(&s, '@');
-  string_builder__append_cstr(&s, (hostname != NULL) ? hostname : "fishydino");
-  string_builder__append_cstr(&s, ANSI_COLOR_BOLD_BLACK);
-  string_builder__append_char(&s, ':');
-  string_builder__append_cstr(&s, ANSI_COLOR_BOLD_YELLOW);
-  string_builder__append_cstr(&s, (cwd != NULL) ? cwd : "~");
-  string_builder__append_cstr(&s, ANSI_COLOR_RESET);
-  string_builder__append_cstr(&s, "$ ");
-  
-  prompt_len += strlen((username != NULL) ? username : "daniel");
-  prompt_len += strlen((hostname != NULL) ? hostname : "fishydino");
-  prompt_len += strlen((cwd != NULL) ? cwd : "~");
-  prompt_len += 4;
-
-  rfree(hostname);
-  rfree(username);
-  rfree(cwd);
-  
-  string result = string_builder__to_string(&s);
-  string_builder__free(&s);
-  return result;
-}
\ No newline at end of file
+  }
+  reader.active = false;
+  loop_leave();
+  TRACE_END(readline_start, "readline");
+  string input = reader.line != NULL ? string__new(reader.line) : _SLIT0;
+  free(reader.line);
+  reader.line = NULL;
+  prompt = _SLIT0;
+  return input;
+}
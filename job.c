@@ -154,6 +154,16 @@ void cleanup_jobs(void) {
   }
 }
 
+/* Peeks at the jobs without reaping them, so print_job_status() still sees
+ * the same state changes. */
+bool job_status_changed(void) {
+  for (Job* job = job_list.first_job; job != NULL; job = job->next) {
+    siginfo_t info = {0};
+    if (waitid(P_PGID, (id_t)job->pgid, &info, WEXITED | WNOHANG | WNOWAIT) == 0 && info.si_pid != 0) return true;
+  }
+  return false;
+}
+
 void print_job_status(void) {
   Job* job = job_list.first_job;
   Job* prev = NULL;
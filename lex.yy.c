@@ -487,6 +487,7 @@ char *yytext;
 #include "pipeline.h"
 #include "parser.tab.h"
 #include "rstring.h"
+#include "highlight.h"
 
 #define YY_NO_INPUT
 #define YY_NO_UNPUT
@@ -1924,5 +1925,18 @@ void yyfree (void * ptr )
 #line 50 "lexer.l"
 
 
+/* Lets the line highlighter run this DFA without touching the scanner state. */
+const LexTables rick_lex_tables = {
+  .accept = yy_accept,
+  .ec = yy_ec,
+  .meta = yy_meta,
+  .base = yy_base,
+  .def = yy_def,
+  .nxt = yy_nxt,
+  .chk = yy_chk,
+  .states = (int)(sizeof(yy_accept) / sizeof(yy_accept[0])),
+  .default_rule = YY_NUM_RULES,
+};
+
 #undef YY_NO_INPUT
 #undef YY_NO_UNPUT
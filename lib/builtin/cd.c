@@ -13,6 +13,7 @@
 #include "rstring.h"
 #include "array.h"
 #include "io.h"
+#include "prompt.h"
 
 static char old_pwd[4096] = {0};
 
@@ -62,6 +63,7 @@ static int change_dir(const char *dir, int follow_symlinks, int exit_on_error, i
   }
   
   setenv("PWD", new_pwd, 1);
+  prompt_invalidate(Prompt_Cwd);
   
   if (print_new_dir) {
     fprintln("%s", new_pwd);
@@ -3,90 +3,16 @@
 #include <stdbool.h>
 #include <string.h>
 #include <ctype.h>
+#include <unistd.h>
 #include "builtin.h"
 #include "io.h"
 #include "variable.h"
 #include "memory.h"
 #include "rstring.h"
 #include "array.h"
-#include "iterator.h"
-
-#ifdef SREPLACE
-  #undef SREPLACE
-#endif
-#define SREPLACE(v, s) { \
-  string _##v = string__concat(v, s); \
-  string__free(v); \
-  v = _##v; \
-}
 
 extern VariableTable* variable_table;
 
-static void print_variable(Variable* var) {
-  if (!is_variable_any_flag_set(&var->flags)) return;
-  string flags = _SLIT0;
-  switch (var->value.type) {
-    case VAR_INTEGER:
-      flags = string__concat(flags, _SLIT("i"));
-      break;
-    case VAR_ARRAY:
-      flags = string__concat(flags, _SLIT("a"));
-      break;
-    case VAR_ASSOCIATIVE_ARRAY:
-      flags = string__concat(flags, _SLIT("A"));
-      break;
-    case VAR_NAMEREF:
-      flags = string__concat(flags, _SLIT("n"));
-      break;
-    default:
-      break;
-  }
-  if (is_variable_flag_set(&var->flags, VarFlag_ReadOnly)) SREPLACE(flags, _SLIT("r"));
-  if (is_variable_flag_set(&var->flags, VarFlag_Exported)) SREPLACE(flags, _SLIT("x"));
-  if (is_variable_flag_set(&var->flags, VarFlag_Uppercase)) SREPLACE(flags, _SLIT("u"));
-  if (is_variable_flag_set(&var->flags, VarFlag_Lowercase)) SREPLACE(flags, _SLIT("l"));
-
-  ffprint(stdout, "declare -%S ", flags);
-
-  ffprint(stdout, "%S", var->name);
-
-  switch (var->value.type) {
-    case VAR_INTEGER:
-      ffprint(stdout, "=%lld", var->value._number);
-      break;
-    case VAR_ARRAY: {
-      ffprint(stdout, "=(");
-      for (int i = 0; i < var->array_size; i++) {
-        if (i > 0) ffprint(stdout, " ");
-        ffprint(stdout, "\"%S\"", ((string*)var->value._array.data)[i]);
-      }
-      ffprint(stdout, ")");
-      break;
-    }
-    case VAR_ASSOCIATIVE_ARRAY: {
-      ffprint(stdout, "={ ");
-      MapIterator it = map_iterator(var->value._map);
-      bool first = true;
-      while (map_has_next(&it)) {
-        const char* key = map_next(&it);
-        size_t value_size;
-        void* value = map_iterator_get_value(&it, &value_size);
-        if (!first) ffprint(stdout, " ");
-        ffprint(stdout, "[%s]=\"%S\"", key, *(string*)value);
-        first = false;
-      }
-      ffprint(stdout, " }");
-      break;
-    }
-    default:
-      ffprint(stdout, "=\"%S\"", var->str);
-      break;
-  }
-
-  ffprintln(stdout, "");
-  string__free(flags);
-}
-
 int builtin_declare(Command *cmd) {
   if (cmd->argv.size < 2) {
     ffprintln(stderr, "declare: usage: declare [-aAilnprux] [-I] [name[=value] ...]");
@@ -128,8 +54,7 @@ int builtin_declare(Command *cmd) {
       }
 
       if (print_only) {
-        for (size_t j = 0; j < (size_t)variable_table->size; j++)
-          print_variable(&variable_table->variables[j]);
+        dump_variables(variable_table, 0, VarDump_Declare, STDOUT_FILENO);
         break;
       }
     } else {
@@ -214,5 +139,3 @@ int builtin_declare(Command *cmd) {
 
   return 0;
 }
-
-#undef SREPLACE
\ No newline at end of file
@@ -3,35 +3,36 @@
 #include <string.h>
 #include <stdbool.h>
 #include <wchar.h>
+#include <unistd.h>
 #include "builtin.h"
 #include "expr.h"
 #include "rstring.h"
 #include "array.h"
 #include "unicode.h"
+#include "io.h"
 
-static int process_escape(const string str, int *i) {
-  int result = 0;
+static int process_escape(StringBuilder* out, const string str, int *i) {
   char utf8_buffer[5] = {0};
   size_t utf8_len;
 
   switch (str.str[*i + 1]) {
-    case '\\': result = putchar('\\'); break;
-    case 'a': result = putchar('\a'); break;
-    case 'b': result = putchar('\b'); break;
+    case '\\': string_builder__append_char(out, '\\'); break;
+    case 'a': string_builder__append_char(out, '\a'); break;
+    case 'b': string_builder__append_char(out, '\b'); break;
     case 'c': return -1;
-    case 'e': case 'E': result = putchar('\033'); break;
-    case 'f': result = putchar('\f'); break;
-    case 'n': result = putchar('\n'); break;
-    case 'r': result = putchar('\r'); break;
-    case 't': result = putchar('\t'); break;
-    case 'v': result = putchar('\v'); break;
+    case 'e': case 'E': string_builder__append_char(out, '\033'); break;
+    case 'f': string_builder__append_char(out, '\f'); break;
+    case 'n': string_builder__append_char(out, '\n'); break;
+    case 'r': string_builder__append_char(out, '\r'); break;
+    case 't': string_builder__append_char(out, '\t'); break;
+    case 'v': string_builder__append_char(out, '\v'); break;
     case '0':
       {
         int octal = 0;
         int j;
         for (j = 1; j <= 3 && str.str[*i + j] >= '0' && str.str[*i + j] <= '7'; j++)
           octal = octal * 8 + (str.str[*i + j] - '0');
-        result = putchar(octal);
+        string_builder__append_char(out, (char)octal);
         *i += j - 1;
       }
       break;
@@ -45,7 +46,7 @@ static int process_escape(const string str, int *i) {
           hex = hex * 16 + (str.str[*i + j] <= '9' ? str.str[*i + j] - '0' :
                            (str.str[*i + j] | 32) - 'a' + 10);
         }
-        result = putchar(hex);
+        string_builder__append_char(out, (char)hex);
         *i += j - 1;
       }
       break;
@@ -69,16 +70,48 @@ static int process_escape(const string str, int *i) {
         }
         UnicodeResult ur = unicode_to_utf8(unicode, utf8_buffer, sizeof(utf8_buffer), &utf8_len);
         if (!ur.is_err) {
-          fwrite(utf8_buffer, 1, utf8_len, stdout);
+          string_builder__append(out, (string){.str = utf8_buffer, .len = utf8_len, .is_lit = 1});
         }
         *i += j - 1;
       }
       break;
     default:
-      result = putchar('\\');
-      if (result != EOF) result = putchar(str.str[*i + 1]);
+      string_builder__append_char(out, '\\');
+      string_builder__append_char(out, str.str[*i + 1]);
+  }
+  return 0;
+}
+
+static void append_escaped(StringBuilder* out, const string elem, bool* stop) {
+  int j = 0;
+  while ((size_t)j < elem.len) {
+    const char* bs = memchr(elem.str + j, '\\', elem.len - (size_t)j);
+    size_t run = (bs != NULL) ? (size_t)(bs - (elem.str + j)) : elem.len - (size_t)j;
+    if (run > 0) {
+      string_builder__append(out, (string){.str = elem.str + j, .len = run, .is_lit = 1});
+      j += (int)run;
+    }
+    if (bs == NULL) return;
+
+    if ((size_t)j + 1 < elem.len) {
+      if (process_escape(out, elem, &j) == -1) {
+        *stop = true;
+        return;
+      }
+      j += 2;
+    } else {
+      string_builder__append_char(out, '\\');
+      j++;
+    }
   }
-  return (result == EOF) ? -1 : 0;
+}
+
+static int flush_output(StringBuilder* out) {
+  int status = 0;
+  if (fflush(stdout) == EOF || _write(STDOUT_FILENO, out->buffer, out->len) != (ssize_t)out->len)
+    status = 1;
+  string_builder__free(out);
+  return status;
 }
 
 int builtin_echo(Command *cmd) {
@@ -108,36 +141,30 @@ int builtin_echo(Command *cmd) {
     start_index++;
   }
 end_option_processing:
-  bool first_arg = true;
+  size_t capacity = 1;
+  for (size_t i = start_index; i < cmd->argv.size; i++)
+    capacity += ((string*)array_checked_get(cmd->argv, i))->len + 1;
+  StringBuilder out = string_builder__with_capacity(capacity);
+
   for (size_t i = start_index; i < cmd->argv.size; i++) {
-    if (!first_arg) {
-      if (putchar(' ') == EOF) return 1;
-    }
-    first_arg = false;
+    if (i > start_index)
+      string_builder__append_char(&out, ' ');
 
     string elem = *(string*)array_checked_get(cmd->argv, i);
     if (interpret_escapes) {
-      for (int j = 0; (size_t)j < elem.len; j++) {
-        if (elem.str[j] == '\\' && (size_t)j + 1 < elem.len) {
-          int result = process_escape(elem, &j);
-          if (result == -1) {
-            return 0;
-          } else if (result != 0) {
-            return 1;
-          }
-          j++;
-        } else {
-          if (putchar(elem.str[j]) == EOF) return 1;
-        }
+      bool stop = false;
+      append_escaped(&out, elem, &stop);
+      if (stop) {
+        flush_output(&out);
+        return 0;
       }
     } else {
-      if (fputs(elem.str, stdout) == EOF) return 1;
+      string_builder__append(&out, elem);
     }
   }
 
-  if (print_newline) {
-    if (putchar('\n') == EOF) return 1;
-  }
+  if (print_newline)
+    string_builder__append_char(&out, '\n');
 
-  return 0;
+  return flush_output(&out);
 }
\ No newline at end of file
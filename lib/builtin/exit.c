@@ -10,6 +10,7 @@
 
 extern volatile sig_atomic_t keep_running;
 extern volatile int last_status;
+extern bool interactive;
 
 int builtin_exit(Command *cmd) {
   last_status = 0;
@@ -20,7 +21,7 @@ int builtin_exit(Command *cmd) {
     if (result.is_err) ffprintln(stderr, "exit: %S: numeric argument required", code);
     last_status = status;
   }
-  println(_SLIT("exit"));
+  if (interactive) println(_SLIT("exit"));
   keep_running = 0;
   return 0;
 }
\ No newline at end of file
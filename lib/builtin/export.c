@@ -1,6 +1,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 #include "builtin.h"
 #include "variable.h"
 #include "io.h"
@@ -45,11 +46,7 @@ int builtin_export(Command *cmd) {
   }
 
   if (print_all) {
-    for (int j = 0; j < variable_table->size; j++) {
-      Variable *var = &variable_table->variables[j];
-      if (is_variable_flag_set(&var->flags, VarFlag_Exported))
-        ffprintln(stdout, "declare -x %S=\"%S\"", var->name, var->str);
-    }
+    dump_variables(variable_table, VarFlag_Exported, VarDump_Declare, STDOUT_FILENO);
     if (i == cmd->argv.size)
       return 0;
   }
@@ -0,0 +1,62 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include "builtin.h"
+#include "expr.h"
+#include "rstring.h"
+#include "array.h"
+#include "fuzzy.h"
+#include "picker.h"
+#include "memory.h"
+#include "io.h"
+
+int builtin_fuzzy(Command *cmd) {
+  int walk = 0;
+  const char* query = "";
+  const char* root = ".";
+
+  for (size_t i = 1; i < cmd->argv.size; i++) {
+    string arg = *(string*)array_get(cmd->argv, i);
+    if (arg.len < 2 || arg.str[0] != '-') {
+      root = arg.str;
+      continue;
+    }
+    /* Short options combine as in -fd; -q takes the rest of the word or the next one. */
+    for (size_t j = 1; j < arg.len; j++) {
+      switch (arg.str[j]) {
+        case 'f': walk |= PICKER_WALK_FILES; break;
+        case 'd': walk |= PICKER_WALK_DIRS; break;
+        case 'q':
+          if (j + 1 < arg.len) {
+            query = arg.str + j + 1;
+          } else if (++i < cmd->argv.size) {
+            query = (*(string*)array_get(cmd->argv, i)).str;
+          } else {
+            ffprintln(stderr, "fuzzy: -q: option requires an argument");
+            return 2;
+          }
+          j = arg.len;
+          break;
+        default:
+          ffprintln(stderr, "fuzzy: -%c: invalid option", arg.str[j]);
+          return 2;
+      }
+    }
+  }
+
+  FuzzySet set;
+  fuzzy_set_init(&set);
+  if (walk != 0) picker_load_files(&set, root, walk);
+  else if (!isatty(STDIN_FILENO)) picker_load_lines(&set, STDIN_FILENO);
+  else picker_load_history(&set);
+
+  char* choice = picker_run(&set, query);
+  fuzzy_set_free(&set);
+  if (choice == NULL) return 1;
+  printf("%s\n", choice);
+  fflush(stdout);
+  rfree(choice);
+  return 0;
+}
@@ -41,25 +41,6 @@ static HistoryFlags parse_flags(const string flag_str) {
   return flags;
 }
 
-static bool handle_file_operation(const char* operation, history_op_t func) {
-  const char* hist_env = getenv("HISTFILE");
-  const char* path = hist_env ? hist_env : DEFAULT_HISTFILE;
-  char* filename = expand_home_directory(path);
-  if (!filename) {
-    fprintf(stderr, "Failed to %s: Could not get history file path\n", operation);
-    return false;
-  }
-
-  if (func(filename) != 0) {
-    fprintf(stderr, "Failed to %s: %s\n", operation, strerror(errno));
-    free(filename);
-    return false;
-  }
-
-  free(filename);
-  return true;
-}
-
 static void print_history_entry(int index, const char* time_format, const HIST_ENTRY* entry) {
   if (!entry || !entry->line) {
     return;
@@ -67,8 +48,9 @@ static void print_history_entry(int index, const char* time_format, const HIST_E
 
   if (time_format) {
     char time_str[MAX_TIME_STR_LEN];
-    time_t now = time(NULL);
-    struct tm* tm_info = localtime(&now);
+    time_t when = history_get_time((HIST_ENTRY*)entry);
+    if (when == 0) when = time(NULL);
+    struct tm* tm_info = localtime(&when);
     
     if (tm_info && strftime(time_str, sizeof(time_str), time_format, tm_info) > 0) {
       printf("%5d  %s  %s\n", index + 1, time_str, entry->line);
@@ -116,7 +98,7 @@ static bool store_history_entry(const Command* cmd, size_t start_idx) {
       string_builder__free(&sb);
       return false;
     }
-    add_history(content.str);
+    history_file_append(content.str);
     string__free(content);
     do_not_save_history = true;
     reset_last_command();
@@ -157,10 +139,6 @@ static bool handle_print_expand(const Command* cmd, size_t start_idx) {
 }
 
 
-static int append_history_wrapper(const char* filename) {
-  return append_history(history_length, filename);
-}
-
 int builtin_history(Command* cmd) {
   if (!cmd || cmd->argv.size < 1)
     return 1;
@@ -224,13 +202,22 @@ int builtin_history(Command* cmd) {
   }
 
   if (flags.read_file) {
-    clear_history();
-    return handle_file_operation("read_history", read_history) ? 0 : 1;
+    if (history_file_reload()) return 0;
+    fprintf(stderr, "Failed to read history file: %s\n", strerror(errno));
+    return 1;
   }
 
-  if (flags.read_new) return handle_file_operation("read_history", read_history) ? 0 : 1;
-  if (flags.append) return handle_file_operation("append_history", append_history_wrapper) ? 0 : 1;
-  if (flags.write) return handle_file_operation("write_history", write_history) ? 0 : 1;
+  if (flags.read_new) {
+    if (history_file_read_new()) return 0;
+    fprintf(stderr, "Failed to read new history entries: %s\n", strerror(errno));
+    return 1;
+  }
+  if (flags.append) return 0;
+  if (flags.write) {
+    if (history_file_compact()) return 0;
+    fprintf(stderr, "Failed to write history file: %s\n", strerror(errno));
+    return 1;
+  }
 
   for (int i = 0; i < hist_len; i++)
     print_history_entry(i, time_format, hist_list[i]);
@@ -4,6 +4,7 @@
 #include <stdbool.h>
 #include <ctype.h>
 #include <time.h>
+#include <unistd.h>
 #include "builtin.h"
 #include "expr.h"
 #include "rstring.h"
@@ -230,6 +231,149 @@ static string format_time(const string format, time_t t) {
   return result;
 }
 
+typedef enum {
+  PrintfSegment_Literal,
+  PrintfSegment_Conversion,
+} PrintfSegmentType;
+
+typedef struct {
+  PrintfSegmentType type;
+  string text;
+  char conversion;
+} PrintfSegment;
+
+static bool compile_format(const string format, array* segments) {
+  size_t literal_start = 0;
+  for (size_t i = 0; i < format.len; i++) {
+    if (format.str[i] != '%' || i + 1 >= format.len) continue;
+
+    if (i > literal_start) {
+      PrintfSegment literal = {PrintfSegment_Literal, {format.str + literal_start, i - literal_start, 1}, 0};
+      array_push(segments, &literal);
+    }
+
+    char c = format.str[++i];
+    PrintfSegment seg = {PrintfSegment_Conversion, _SLIT0, c};
+    switch (c) {
+      case '%':
+        seg.type = PrintfSegment_Literal;
+        seg.text = _SLIT("%");
+        break;
+      case 's': case 'd': case 'f': case 'x': case 'b': case 'q':
+        break;
+      case 'T':
+        if (i + 1 < format.len && format.str[i + 1] == '(') {
+          size_t end = i + 2;
+          while (end < format.len && format.str[end] != ')') end++;
+          if (end < format.len) {
+            seg.text = (string){format.str + i + 2, end - i - 2, 1};
+            i = end;
+            break;
+          }
+        }
+        seg.type = PrintfSegment_Literal;
+        break;
+      default:
+        ffprintln(stderr, "printf: invalid format character: %c", c);
+        return false;
+    }
+    if (seg.type == PrintfSegment_Conversion || seg.text.len > 0)
+      array_push(segments, &seg);
+    literal_start = i + 1;
+  }
+
+  if (literal_start < format.len) {
+    PrintfSegment literal = {PrintfSegment_Literal, {format.str + literal_start, format.len - literal_start, 1}, 0};
+    array_push(segments, &literal);
+  }
+  return true;
+}
+
+static void render_conversion(StringBuilder* output, const PrintfSegment* seg, const string* arg) {
+  switch (seg->conversion) {
+    case 's':
+      string_builder__append(output, *arg);
+      break;
+    case 'd': {
+      int value;
+      if (ratoi(*arg, &value).is_err) {
+        ffprintln(stderr, "printf: invalid number: %S", *arg);
+        break;
+      }
+      string_builder__append_int(output, value);
+      break;
+    }
+    case 'f': {
+      double value;
+      if (ratod(*arg, &value).is_err) {
+        ffprintln(stderr, "printf: invalid float: %S", *arg);
+        break;
+      }
+      string_builder__append_double(output, value);
+      break;
+    }
+    case 'x': {
+      long value;
+      if (ratol(*arg, &value).is_err) {
+        ffprintln(stderr, "printf: invalid number: %S", *arg);
+        break;
+      }
+      char hex_buffer[16];
+      size_t hex_index = sizeof(hex_buffer);
+      unsigned long bits = (unsigned long)value;
+      do {
+        unsigned long digit = bits & 0xF;
+        hex_buffer[--hex_index] = (char)(digit < 10 ? '0' + digit : 'a' + (digit - 10));
+        bits >>= 4;
+      } while (bits);
+      string_builder__append(output, (string){hex_buffer + hex_index, sizeof(hex_buffer) - hex_index, 1});
+      break;
+    }
+    case 'b': {
+      string processed = process_escape_sequences(*arg);
+      string_builder__append(output, processed);
+      string__free(processed);
+      break;
+    }
+    case 'q': {
+      string quoted = format_quoted_string(*arg);
+      string_builder__append(output, quoted);
+      string__free(quoted);
+      break;
+    }
+    case 'T': {
+      time_t t = (arg != NULL) ? atoi(arg->str) : -1;
+      if (t == -1) t = time(NULL);
+      string time_format = string__from(seg->text);
+      string time_str = format_time(time_format, t);
+      string_builder__append(output, time_str);
+      string__free(time_str);
+      string__free(time_format);
+      break;
+    }
+    default:
+      break;
+  }
+}
+
+static size_t render_format(StringBuilder* output, const array* segments, const StringArray* argv, size_t arg_index) {
+  size_t consumed = 0;
+  for (size_t i = 0; i < segments->size; i++) {
+    const PrintfSegment* seg = array_checked_get(*segments, i);
+    if (seg->type == PrintfSegment_Literal) {
+      string_builder__append(output, seg->text);
+      continue;
+    }
+
+    const string* arg = NULL;
+    if (arg_index + consumed < argv->size)
+      arg = array_get(*argv, arg_index + consumed++);
+    if (arg != NULL || seg->conversion == 'T')
+      render_conversion(output, seg, arg);
+  }
+  return consumed;
+}
+
 int builtin_printf(Command *cmd) {
   if (cmd->argv.size < 2) {
     ffprintln(stderr, "printf: usage: printf [-v var] format [arguments]");
@@ -248,152 +392,36 @@ int builtin_printf(Command *cmd) {
     arg_start = 3;
   }
 
-  string format = *(string*)array_get(cmd->argv, arg_start);
-  format = process_escape_sequences(format);
+  string format = process_escape_sequences(*(string*)array_get(cmd->argv, arg_start));
+  array segments = create_array(sizeof(PrintfSegment));
+  if (!compile_format(format, &segments)) {
+    array_free(&segments);
+    string__free(format);
+    return 1;
+  }
 
-  StringBuilder output = string_builder__new();
   size_t arg_index = arg_start + 1;
+  size_t pending = cmd->argv.size - arg_index;
+  StringBuilder output = string_builder__with_capacity(format.len + pending * 16 + 1);
+  do {
+    size_t consumed = render_format(&output, &segments, &cmd->argv, arg_index);
+    if (consumed == 0) break;
+    arg_index += consumed;
+  } while (arg_index < cmd->argv.size);
 
-  for (size_t i = 0; i < format.len; i++) {
-    if (format.str[i] == '%' && i + 1 < format.len) {
-      i++;
-      switch (format.str[i]) {
-        case '%':
-          string_builder__append_char(&output, '%');
-          break;
-        case 's': {
-          if (arg_index < cmd->argv.size) {
-            string arg = *(string*)array_get(cmd->argv, arg_index++);
-            string_builder__append(&output, arg);
-          }
-          break;
-        }
-        case 'd': {
-          if (arg_index < cmd->argv.size) {
-            string arg = *(string*)array_get(cmd->argv, arg_index++);
-            int value;
-            StrconvResult result;
-            result = ratoi(arg, &value);
-            if (!result.is_err) {
-              result = ritoa(value);
-              if (!result.is_err) {
-                string num_str = *(string*)result.value;
-                string_builder__append(&output, num_str);
-                string__free(num_str);
-              } else {
-                ffprintln(stderr, "printf: invalid number: %S", arg);
-              }
-            } else {
-              ffprintln(stderr, "printf: invalid number: %S", arg);
-            }
-          }
-          break;
-        }
-        case 'f': {
-          if (arg_index < cmd->argv.size) {
-            string arg = *(string*)array_get(cmd->argv, arg_index++);
-            double value;
-            StrconvResult result;
-            result = ratod(arg, &value);
-            if (!result.is_err) {
-              result = rdtos(value);
-              if (!result.is_err) {
-                string num_str = *(string*)result.value;
-                string_builder__append(&output, num_str);
-                string__free(num_str);
-              } else {
-                ffprintln(stderr, "printf: invalid float: %S", arg);
-              }
-            } else {
-              ffprintln(stderr, "printf: invalid float: %S", arg);
-            }
-          }
-          break;
-        }
-        case 'x': {
-          if (arg_index < cmd->argv.size) {
-            string arg = *(string*)array_get(cmd->argv, arg_index++);
-            long value;
-            StrconvResult result = ratol(arg, &value);
-            if (!result.is_err) {
-              StringBuilder hex_sb = string_builder__new();
-              char hex_buffer[16];
-              int hex_index = 0;
-              do {
-                int digit = value & 0xF;
-                hex_buffer[hex_index++] = (char)(digit < 10 ? '0' + digit : 'a' + (digit - 10));
-                value >>= 4;
-              } while (value);
-              for (int j = hex_index - 1; j >= 0; j--) {
-                char hex_digit[2] = {hex_buffer[j], '\0'};
-                string_builder__append_cstr(&hex_sb, hex_digit);
-              }
-              string hex_str = string_builder__to_string(&hex_sb);
-              string_builder__append(&output, hex_str);
-              string__free(hex_str);
-              string_builder__free(&hex_sb);
-            } else {
-              ffprintln(stderr, "printf: invalid number: %S", arg);
-            }
-          }
-          break;
-        }
-        case 'b': {
-          if (arg_index < cmd->argv.size) {
-            string arg = *(string*)array_get(cmd->argv, arg_index++);
-            string processed = process_escape_sequences(arg);
-            string_builder__append(&output, processed);
-            string__free(processed);
-          }
-          break;
-        }
-        case 'q': {
-          if (arg_index < cmd->argv.size) {
-            string arg = *(string*)array_get(cmd->argv, arg_index++);
-            string quoted = format_quoted_string(arg);
-            string_builder__append(&output, quoted);
-            string__free(quoted);
-          }
-          break;
-        }
-        case 'T': {
-          if (i + 1 < format.len && format.str[i + 1] == '(') {
-            size_t end = i + 2;
-            while (end < format.len && format.str[end] != ')') end++;
-            if (end < format.len) {
-              string time_format = string__substring(format, (ssize_t)i + 2, (ssize_t)end);
-              time_t t = (arg_index < cmd->argv.size) ? atoi(((string*)array_get(cmd->argv, arg_index++))->str) : -1;
-              if (t == -1) t = time(NULL);
-              string time_str = format_time(time_format, t);
-              string_builder__append(&output, time_str);
-              string__free(time_str);
-              string__free(time_format);
-              i = end;
-            }
-          }
-          break;
-        }
-        default:
-          ffprintln(stderr, "printf: invalid format character: %c", format.str[i]);
-          string_builder__free(&output);
-          string__free(format);
-          return 1;
-      }
-    } else {
-      string_builder__append_char(&output, format.str[i]);
-    }
-  }
-
-  string result = string_builder__to_string(&output);
-  string_builder__free(&output);
+  array_free(&segments);
   string__free(format);
 
+  int status = 0;
   if (var_name.len > 0) {
-    set_variable(variable_table, var_name, result, VAR_STRING, false);
-  } else {
-    fprint("%S", result);
+    string result = string_builder__to_string(&output);
+    if (set_variable(variable_table, var_name, result, VAR_STRING, false) == NULL)
+      status = 1;
+    string__free(result);
+  } else if (fflush(stdout) == EOF || _write(STDOUT_FILENO, output.buffer, output.len) != (ssize_t)output.len) {
+    status = 1;
   }
 
-  string__free(result);
-  return 0;
-}
\ No newline at end of file
+  string_builder__free(&output);
+  return status;
+}
@@ -48,15 +48,7 @@ int builtin_readonly(Command *cmd) {
   }
 
   if (display_all) {
-    for (int i = 0; i < variable_table->size; i++) {
-      Variable *var = &variable_table->variables[i];
-      if (is_variable_flag_set(&var->flags, VarFlag_ReadOnly)) {
-        string value = va_value_to_string(&var->value);
-        fprintln("readonly %S=%S", var->name, value);
-        string__free(value);
-      }
-    }
-    return 0;
+    return dump_variables(variable_table, VarFlag_ReadOnly, VarDump_Declare, STDOUT_FILENO) ? 0 : 1;
   }
 
   for (size_t i = (size_t)option_end; i < cmd->argv.size; i++) {
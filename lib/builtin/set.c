@@ -18,6 +18,9 @@ int builtin_set(Command* cmd) {
     return -1;
   }
 
+  if (cmd->argv.size == 1)
+    return dump_variables(variable_table, 0, VarDump_Assign, STDOUT_FILENO) ? 0 : 1;
+
   for (size_t i = 1; i < cmd->argv.size; i++) {
     string elem = *(string*)array_checked_get(cmd->argv, i);
     ssize_t equals_pos = string__indexof(elem, _SLIT("="));
@@ -3,6 +3,8 @@
 #include <string.h>
 #include <time.h>
 #include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
 #include <sys/stat.h>
 #include <unistd.h>
 #include <errno.h>
@@ -11,12 +13,13 @@
 #include "log.h"
 #include "rstring.h"
 #include "io.h"
-#include "strconv.h"
 
 #define MAX_LOG_MESSAGE_LENGTH 2048
 #define DEFAULT_MAX_FILE_SIZE (10 * 1024 * 1024) // 10 MB
 #define DEFAULT_MAX_BACKUP_FILES 5
 #define DEFAULT_LOG_FORMAT _SLIT("[%Y-%m-%d %H:%M:%S] [%L] [%p] (%a) %f:%l (%n): %m")
+#define DEFAULT_ASYNC_QUEUE_SIZE 1024
+#define LOG_ASYNC_IDLE_WAIT_MS 100
 
 static const string level_strings[] = {
   _SLIT("TRACE"), _SLIT("DEBUG"), _SLIT("INFO"), _SLIT("WARN"), _SLIT("ERROR"), _SLIT("FATAL")
@@ -26,6 +29,39 @@ static const string level_colors[] = {
   _SLIT("\x1b[94m"), _SLIT("\x1b[36m"), _SLIT("\x1b[32m"), _SLIT("\x1b[33m"), _SLIT("\x1b[31m"), _SLIT("\x1b[35m")
 };
 
+typedef enum {
+  LogToken_Literal,
+  LogToken_Year,
+  LogToken_Month,
+  LogToken_Day,
+  LogToken_Hour,
+  LogToken_Minute,
+  LogToken_Second,
+  LogToken_Level,
+  LogToken_Pid,
+  LogToken_File,
+  LogToken_Line,
+  LogToken_Func,
+  LogToken_App,
+  LogToken_Message,
+} LogTokenType;
+
+typedef struct {
+  LogTokenType type;
+  string text;
+} LogToken;
+
+typedef struct {
+  _Atomic size_t sequence;
+  LogLevel level;
+  int line;
+  const char* file;
+  const char* func;
+  time_t timestamp;
+  size_t message_len;
+  char message[MAX_LOG_MESSAGE_LENGTH];
+} LogRecord;
+
 static struct {
   LogLevel level;
   FILE* file;
@@ -38,6 +74,16 @@ static struct {
   bool file_output_only;
   string log_format;
   string app_name;
+  LogToken* tokens;
+  size_t token_count;
+  unsigned long long file_size;
+  struct {
+    time_t second;
+    char fields[6][8];
+    size_t lengths[6];
+  } clock;
+  char pid[16];
+  size_t pid_len;
 } log_ctx = {
   .level = LOG_LEVEL_INFO,
   .file = NULL,
@@ -49,7 +95,33 @@ static struct {
   .append_mode = true,
   .file_output_only = true,
   .log_format = _SLIT0,
-  .app_name = _SLIT0
+  .app_name = _SLIT0,
+  .tokens = NULL,
+  .token_count = 0,
+  .file_size = 0,
+  .clock = { .second = -1 },
+  .pid_len = 0
+};
+
+static struct {
+  bool active;
+  LogRecord* slots;
+  size_t mask;
+  _Atomic size_t head;
+  size_t tail;
+  _Atomic size_t consumed;
+  _Atomic size_t dropped;
+  _Atomic bool idle;
+  _Atomic bool stopping;
+  pthread_t thread;
+  pthread_mutex_t wait_mutex;
+  pthread_cond_t wait_cond;
+  pthread_cond_t drained_cond;
+} log_async = {
+  .active = false,
+  .wait_mutex = PTHREAD_MUTEX_INITIALIZER,
+  .wait_cond = PTHREAD_COND_INITIALIZER,
+  .drained_cond = PTHREAD_COND_INITIALIZER
 };
 
 static void ensure_log_file_open(void) {
@@ -59,7 +131,264 @@ static void ensure_log_file_open(void) {
       ffprintln(stderr, "Failed to open log file: %S (Error: %s)", log_ctx.filename, strerror(errno));
       exit(EXIT_FAILURE);
     }
+    struct stat st;
+    log_ctx.file_size = (fstat(fileno(log_ctx.file), &st) == 0) ? (unsigned long long)st.st_size : 0;
+  }
+}
+
+static void compile_log_format(void) {
+  const string format = log_ctx.log_format;
+  rfree(log_ctx.tokens);
+  log_ctx.tokens = rmalloc((format.len + 1) * sizeof(LogToken));
+  log_ctx.token_count = 0;
+
+  size_t literal_start = 0;
+  for (size_t i = 0; i < format.len; i++) {
+    if (format.str[i] != '%' || i + 1 >= format.len) continue;
+
+    LogTokenType type;
+    switch (format.str[i + 1]) {
+      case 'Y': type = LogToken_Year; break;
+      case 'M': type = LogToken_Month; break;
+      case 'd': type = LogToken_Day; break;
+      case 'H': type = LogToken_Hour; break;
+      case 'I': type = LogToken_Minute; break;
+      case 'S': type = LogToken_Second; break;
+      case 'L': type = LogToken_Level; break;
+      case 'p': type = LogToken_Pid; break;
+      case 'f': type = LogToken_File; break;
+      case 'l': type = LogToken_Line; break;
+      case 'n': type = LogToken_Func; break;
+      case 'a': type = LogToken_App; break;
+      case 'm': type = LogToken_Message; break;
+      default: i++; continue;
+    }
+
+    if (i > literal_start)
+      log_ctx.tokens[log_ctx.token_count++] = (LogToken){LogToken_Literal, {format.str + literal_start, i - literal_start, 1}};
+    log_ctx.tokens[log_ctx.token_count++] = (LogToken){type, _SLIT0};
+    literal_start = i + 2;
+    i++;
+  }
+
+  if (literal_start < format.len)
+    log_ctx.tokens[log_ctx.token_count++] = (LogToken){LogToken_Literal, {format.str + literal_start, format.len - literal_start, 1}};
+}
+
+static void refresh_clock(time_t now) {
+  if (now == log_ctx.clock.second) return;
+  static const char* const fields[6] = {"%Y", "%m", "%d", "%H", "%M", "%S"};
+  struct tm time_info;
+  localtime_r(&now, &time_info);
+  for (size_t i = 0; i < 6; i++)
+    log_ctx.clock.lengths[i] = strftime(log_ctx.clock.fields[i], sizeof(log_ctx.clock.fields[i]), fields[i], &time_info);
+  log_ctx.clock.second = now;
+}
+
+static void render_log_message(StringBuilder* sb, time_t now, LogLevel level, const char* file,
+                               int line, const char* func, const string message) {
+  refresh_clock(now);
+  for (size_t i = 0; i < log_ctx.token_count; i++) {
+    const LogToken* token = &log_ctx.tokens[i];
+    switch (token->type) {
+      case LogToken_Literal:
+        string_builder__append(sb, token->text);
+        break;
+      case LogToken_Year: case LogToken_Month: case LogToken_Day:
+      case LogToken_Hour: case LogToken_Minute: case LogToken_Second: {
+        size_t field = (size_t)(token->type - LogToken_Year);
+        string_builder__append(sb, (string){log_ctx.clock.fields[field], log_ctx.clock.lengths[field], 1});
+        break;
+      }
+      case LogToken_Level:
+        string_builder__append(sb, level_strings[level]);
+        break;
+      case LogToken_Pid:
+        string_builder__append(sb, (string){log_ctx.pid, log_ctx.pid_len, 1});
+        break;
+      case LogToken_File:
+        string_builder__append_cstr(sb, file);
+        break;
+      case LogToken_Line:
+        string_builder__append_int(sb, line);
+        break;
+      case LogToken_Func:
+        string_builder__append_cstr(sb, func);
+        break;
+      case LogToken_App:
+        string_builder__append(sb, log_ctx.app_name);
+        break;
+      case LogToken_Message:
+        string_builder__append(sb, message);
+        break;
+    }
+  }
+  string_builder__append_char(sb, '\n');
+}
+
+static void flush_file_batch(StringBuilder* batch) {
+  if (batch->len == 0) return;
+  if (log_ctx.file != NULL) {
+    fwrite(batch->buffer, 1, batch->len, log_ctx.file);
+    fflush(log_ctx.file);
+    log_ctx.file_size += batch->len;
+  }
+  batch->len = 0;
+}
+
+static void emit_log_line(StringBuilder* batch, StringBuilder* console, LogLevel level, const string line) {
+  if (log_ctx.file != NULL && log_ctx.file_size + batch->len + line.len > log_ctx.max_file_size) {
+    flush_file_batch(batch);
+    log_rotate();
+  }
+
+  if (log_ctx.file != NULL)
+    string_builder__append(batch, line);
+
+  if (level >= LOG_LEVEL_ERROR || log_ctx.file == NULL) {
+    if (log_ctx.color_output) {
+      string_builder__append(console, level_colors[level]);
+      string_builder__append(console, (string){line.str, line.len - 1, 1});
+      string_builder__append(console, _SLIT("\x1b[0m\n"));
+    } else {
+      string_builder__append(console, line);
+    }
+  }
+}
+
+static void flush_console(StringBuilder* console) {
+  if (console->len == 0) return;
+  fflush(stderr);
+  _write(STDERR_FILENO, console->buffer, console->len);
+  console->len = 0;
+}
+
+static bool drain_log_queue(StringBuilder* batch, StringBuilder* console, StringBuilder* line) {
+  bool drained = false;
+  size_t dropped = atomic_exchange_explicit(&log_async.dropped, 0, memory_order_relaxed);
+  if (dropped > 0) {
+    char message[64];
+    int len = snprintf(message, sizeof(message), "log queue full, dropped %zu message(s)", dropped);
+    line->len = 0;
+    render_log_message(line, time(NULL), LOG_LEVEL_WARN, __FILE__, __LINE__, __func__, (string){message, (size_t)len, 1});
+    emit_log_line(batch, console, LOG_LEVEL_WARN, (string){line->buffer, line->len, 1});
+  }
+
+  for (;;) {
+    LogRecord* slot = &log_async.slots[log_async.tail & log_async.mask];
+    size_t sequence = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+    if (sequence != log_async.tail + 1) break;
+
+    line->len = 0;
+    render_log_message(line, slot->timestamp, slot->level, slot->file, slot->line, slot->func,
+                       (string){slot->message, slot->message_len, 1});
+    emit_log_line(batch, console, slot->level, (string){line->buffer, line->len, 1});
+
+    atomic_store_explicit(&slot->sequence, log_async.tail + log_async.mask + 1, memory_order_release);
+    log_async.tail++;
+    drained = true;
+  }
+
+  flush_file_batch(batch);
+  flush_console(console);
+  if (drained || dropped > 0) {
+    pthread_mutex_lock(&log_async.wait_mutex);
+    atomic_store_explicit(&log_async.consumed, log_async.tail, memory_order_release);
+    pthread_cond_broadcast(&log_async.drained_cond);
+    pthread_mutex_unlock(&log_async.wait_mutex);
+  }
+  return drained;
+}
+
+static void* log_async_worker(void* arg) {
+  (void)arg;
+  ensure_log_file_open();
+  StringBuilder batch = string_builder__with_capacity(16 * 1024);
+  StringBuilder console = string_builder__new();
+  StringBuilder line = string_builder__with_capacity(MAX_LOG_MESSAGE_LENGTH);
+
+  for (;;) {
+    if (drain_log_queue(&batch, &console, &line)) continue;
+    if (atomic_load(&log_async.stopping)) {
+      drain_log_queue(&batch, &console, &line);
+      break;
+    }
+
+    pthread_mutex_lock(&log_async.wait_mutex);
+    atomic_store(&log_async.idle, true);
+    LogRecord* next = &log_async.slots[log_async.tail & log_async.mask];
+    if (atomic_load(&next->sequence) != log_async.tail + 1 && !atomic_load(&log_async.stopping)) {
+      struct timespec deadline;
+      clock_gettime(CLOCK_REALTIME, &deadline);
+      deadline.tv_nsec += LOG_ASYNC_IDLE_WAIT_MS * 1000000L;
+      if (deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+      }
+      pthread_cond_timedwait(&log_async.wait_cond, &log_async.wait_mutex, &deadline);
+    }
+    atomic_store(&log_async.idle, false);
+    pthread_mutex_unlock(&log_async.wait_mutex);
+  }
+
+  string_builder__free(&batch);
+  string_builder__free(&console);
+  string_builder__free(&line);
+  return NULL;
+}
+
+static void wake_log_worker(void) {
+  if (!atomic_load(&log_async.idle)) return;
+  pthread_mutex_lock(&log_async.wait_mutex);
+  pthread_cond_signal(&log_async.wait_cond);
+  pthread_mutex_unlock(&log_async.wait_mutex);
+}
+
+static void log_after_fork_child(void) {
+  log_async.active = false;
+  log_ctx.pid_len = (size_t)snprintf(log_ctx.pid, sizeof(log_ctx.pid), "%d", getpid());
+}
+
+static void log_async_start(unsigned int queue_size) {
+  size_t capacity = 1;
+  while (capacity < (queue_size > 0 ? queue_size : DEFAULT_ASYNC_QUEUE_SIZE))
+    capacity <<= 1;
+
+  log_async.slots = rcalloc(capacity, sizeof(LogRecord));
+  for (size_t i = 0; i < capacity; i++)
+    atomic_init(&log_async.slots[i].sequence, i);
+  log_async.mask = capacity - 1;
+  atomic_init(&log_async.head, 0);
+  log_async.tail = 0;
+  atomic_init(&log_async.consumed, 0);
+  atomic_init(&log_async.dropped, 0);
+  atomic_init(&log_async.idle, false);
+  atomic_init(&log_async.stopping, false);
+
+  if (pthread_create(&log_async.thread, NULL, log_async_worker, NULL) != 0) {
+    rfree(log_async.slots);
+    log_async.slots = NULL;
+    return;
   }
+
+  static bool atfork_registered = false;
+  if (!atfork_registered) {
+    pthread_atfork(NULL, NULL, log_after_fork_child);
+    atfork_registered = true;
+  }
+  log_async.active = true;
+}
+
+static void log_async_stop(void) {
+  if (!log_async.active) return;
+  atomic_store(&log_async.stopping, true);
+  pthread_mutex_lock(&log_async.wait_mutex);
+  pthread_cond_signal(&log_async.wait_cond);
+  pthread_mutex_unlock(&log_async.wait_mutex);
+  pthread_join(log_async.thread, NULL);
+  log_async.active = false;
+  rfree(log_async.slots);
+  log_async.slots = NULL;
 }
 
 void log_init(const LogConfig* config) {
@@ -71,21 +400,28 @@ void log_init(const LogConfig* config) {
   log_ctx.max_backup_files = config->max_backup_files > 0 ? config->max_backup_files : DEFAULT_MAX_BACKUP_FILES;
   log_ctx.append_mode = config->append_mode;
   log_ctx.file_output_only = config->file_output_only;
+  log_ctx.pid_len = (size_t)snprintf(log_ctx.pid, sizeof(log_ctx.pid), "%d", getpid());
 
   if (!string__is_null_or_empty(config->filename)) {
     char* fname = expand_home_directory(config->filename.str);
     log_ctx.filename = string__new(fname);
-    ensure_log_file_open();
+    if (!config->async_mode) ensure_log_file_open();
     free(fname);
   }
 
   log_ctx.log_format = string__from((!string__is_null_or_empty(config->log_format))? config->log_format : DEFAULT_LOG_FORMAT);
+  compile_log_format();
 
   if (!string__is_null_or_empty(config->name))
     log_ctx.app_name = string__from(config->name);
+
+  /* In async mode the worker opens the file, keeping it off the startup path. */
+  if (config->async_mode)
+    log_async_start(config->async_queue_size);
 }
 
 void log_shutdown(void) {
+  log_async_stop();
   if (log_ctx.file != NULL) {
     fclose(log_ctx.file);
     log_ctx.file = NULL;
@@ -96,6 +432,9 @@ void log_shutdown(void) {
   log_ctx.log_format = _SLIT0;
   string__free(log_ctx.app_name);
   log_ctx.app_name = _SLIT0;
+  rfree(log_ctx.tokens);
+  log_ctx.tokens = NULL;
+  log_ctx.token_count = 0;
 }
 
 void log_set_level(LogLevel level) {
@@ -112,151 +451,105 @@ void log_rotate(void) {
   fclose(log_ctx.file);
   log_ctx.file = NULL;
 
-  for (long i = (long)log_ctx.max_backup_files - 1; i > 0; i--) {
-    StrconvResult olv = rltos(i);
-    if (olv.is_err) continue;
-    StrconvResult nlv = rltos(i + 1);
-    if (nlv.is_err) {
-      string__free(*((string*)olv.value));
-      continue;
-    }
-    string old_name = string__concat_many(3, log_ctx.filename, _SLIT("."), olv);
-    string new_name = string__concat_many(3, log_ctx.filename, _SLIT("."), nlv);
-    string__free(*((string*)olv.value));
-    string__free(*((string*)nlv.value));
-    rename(old_name.str, new_name.str);
-    string__free(old_name);
-    string__free(new_name);
+  size_t name_len = log_ctx.filename.len + 24;
+  char* old_name = rmalloc(name_len);
+  char* new_name = rmalloc(name_len);
+  for (unsigned int i = log_ctx.max_backup_files - 1; i > 0; i--) {
+    snprintf(old_name, name_len, "%s.%u", log_ctx.filename.str, i);
+    snprintf(new_name, name_len, "%s.%u", log_ctx.filename.str, i + 1);
+    rename(old_name, new_name);
   }
-
-  string backup_name = string__concat(log_ctx.filename, _SLIT(".1"));
-  rename(log_ctx.filename.str, backup_name.str);
-  string__free(backup_name);
+  snprintf(new_name, name_len, "%s.1", log_ctx.filename.str);
+  rename(log_ctx.filename.str, new_name);
+  rfree(old_name);
+  rfree(new_name);
 
   ensure_log_file_open();
 }
 
-static void check_file_size(void) {
-  if (log_ctx.file == NULL || string__is_null_or_empty(log_ctx.filename)) return;
-
-  struct stat st;
-  if (stat(log_ctx.filename.str, &st) == 0) {
-    if ((unsigned long long)st.st_size >= log_ctx.max_file_size) {
-      log_rotate();
-    }
+/* Blocks until the worker has written everything queued before the call;
+ * the worker broadcasts drained_cond after each batch. */
+void log_flush(void) {
+  if (!log_async.active) return;
+  size_t target = atomic_load(&log_async.head);
+  pthread_mutex_lock(&log_async.wait_mutex);
+  while (atomic_load_explicit(&log_async.consumed, memory_order_acquire) < target) {
+    pthread_cond_signal(&log_async.wait_cond);
+    pthread_cond_wait(&log_async.drained_cond, &log_async.wait_mutex);
   }
+  pthread_mutex_unlock(&log_async.wait_mutex);
 }
 
-static void format_log_message(string *buffer, const string format, 
-                               const string level_str, const string file, int line, 
-                               const string func, const string message) {
-  time_t now;
-  time(&now);
-  struct tm* time_info = localtime(&now);
-
-  StringBuilder sb = string_builder__new();
-
-  for (size_t i = 0; i < format.len; i++) {
-    if (format.str[i] == '%' && i + 1 < format.len) {
-      i++;
-      char time_buffer[32];
-      switch (format.str[i]) {
-        case 'Y':
-          strftime(time_buffer, sizeof(time_buffer), "%Y", time_info);
-          string_builder__append_cstr(&sb, time_buffer);
-          break;
-        case 'M':
-          strftime(time_buffer, sizeof(time_buffer), "%m", time_info);
-          string_builder__append_cstr(&sb, time_buffer);
-          break;
-        case 'd':
-          strftime(time_buffer, sizeof(time_buffer), "%d", time_info);
-          string_builder__append_cstr(&sb, time_buffer);
-          break;
-        case 'H':
-          strftime(time_buffer, sizeof(time_buffer), "%H", time_info);
-          string_builder__append_cstr(&sb, time_buffer);
-          break;
-        case 'I':
-          strftime(time_buffer, sizeof(time_buffer), "%M", time_info);
-          string_builder__append_cstr(&sb, time_buffer);
-          break;
-        case 'S':
-          strftime(time_buffer, sizeof(time_buffer), "%S", time_info);
-          string_builder__append_cstr(&sb, time_buffer);
-          break;
-        case 'L':string_builder__append(&sb, level_str);
-          break;
-        case 'p':
-          string_builder__append_int(&sb, getpid());
-          break;
-        case 'f':string_builder__append(&sb, file);
-          break;
-        case 'l':
-          string_builder__append_int(&sb, line);
-          break;
-        case 'n':
-          string_builder__append(&sb, func);
-          break;
-        case 'a':
-          if (!string__is_null_or_empty(log_ctx.app_name))
-            string_builder__append(&sb, log_ctx.app_name);
-          break;
-        case 'm':
-          string_builder__append(&sb, message);
-          break;
-        default:
-          string_builder__append_char(&sb, '%');
-          string_builder__append_char(&sb, format.str[i]);
-      }
+static bool log_enqueue(LogLevel level, const char* file, int line, const char* func, const char* format, va_list args) {
+  size_t pos = atomic_load_explicit(&log_async.head, memory_order_relaxed);
+  LogRecord* slot;
+  for (;;) {
+    slot = &log_async.slots[pos & log_async.mask];
+    size_t sequence = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+    if (sequence == pos) {
+      if (atomic_compare_exchange_weak_explicit(&log_async.head, &pos, pos + 1,
+                                                memory_order_relaxed, memory_order_relaxed))
+        break;
+    } else if (sequence < pos) {
+      return false;
     } else {
-      string_builder__append_char(&sb, format.str[i]);
+      pos = atomic_load_explicit(&log_async.head, memory_order_relaxed);
     }
   }
 
-  *buffer = string_builder__to_string(&sb);
-  string_builder__free(&sb);
+  slot->level = level;
+  slot->line = line;
+  slot->file = file;
+  slot->func = func;
+  slot->timestamp = time(NULL);
+  int len = vsnprintf(slot->message, sizeof(slot->message), format, args);
+  slot->message_len = (len < 0) ? 0 : ((size_t)len < sizeof(slot->message) ? (size_t)len : sizeof(slot->message) - 1);
+  atomic_store_explicit(&slot->sequence, pos + 1, memory_order_release);
+
+  wake_log_worker();
+  return true;
 }
 
 void log_write(LogLevel level, const char* file, int line, const char* func, const char* format, ...) {
   if (level < log_ctx.level) return;
 
-  ensure_log_file_open();
-
   va_list args;
   va_start(args, format);
+  if (log_async.active) {
+    va_list retry_args;
+    va_copy(retry_args, args);
+    bool queued = log_enqueue(level, file, line, func, format, args);
+    if (!queued && level >= LOG_LEVEL_ERROR) {
+      log_flush();
+      queued = log_enqueue(level, file, line, func, format, retry_args);
+    }
+    if (!queued)
+      atomic_fetch_add_explicit(&log_async.dropped, 1, memory_order_relaxed);
+    va_end(retry_args);
+    va_end(args);
+    if (level >= LOG_LEVEL_FATAL) log_flush();
+    return;
+  }
+
   char message_cstr[MAX_LOG_MESSAGE_LENGTH];
-  vsnprintf(message_cstr, sizeof(message_cstr), format, args);
+  int len = vsnprintf(message_cstr, sizeof(message_cstr), format, args);
   va_end(args);
-
-  string message = string__new(message_cstr);
-  string sfile = string__new(file);
-  string sfunc = string__new(func);
-  string formatted_message;
-  format_log_message(&formatted_message, log_ctx.log_format, 
-             level_strings[level], sfile, line, sfunc, message);
-  string__free(sfile);
-  string__free(sfunc);
+  size_t message_len = (len < 0) ? 0 : ((size_t)len < sizeof(message_cstr) ? (size_t)len : sizeof(message_cstr) - 1);
 
   pthread_mutex_lock(&log_ctx.mutex);
 
-  check_file_size();
-
-  if (log_ctx.file != NULL) {
-    ffprintln(log_ctx.file, "%S", formatted_message);
-    fflush(log_ctx.file);
-  }
-
-  if (level >= LOG_LEVEL_ERROR || log_ctx.file == NULL) {
-    if (log_ctx.color_output) {
-      ffprintln(stderr, "%S%S\x1b[0m", level_colors[level], formatted_message);
-    } else {
-      ffprintln(stderr, "%S", formatted_message);
-    }
-  }
+  ensure_log_file_open();
+  StringBuilder formatted = string_builder__with_capacity(message_len + 128);
+  StringBuilder batch = string_builder__new();
+  StringBuilder console = string_builder__new();
+  render_log_message(&formatted, time(NULL), level, file, line, func, (string){message_cstr, message_len, 1});
+  emit_log_line(&batch, &console, level, (string){formatted.buffer, formatted.len, 1});
+  flush_file_batch(&batch);
+  flush_console(&console);
 
   pthread_mutex_unlock(&log_ctx.mutex);
 
-  string__free(message);
-  string__free(formatted_message);
-}
\ No newline at end of file
+  string_builder__free(&formatted);
+  string_builder__free(&batch);
+  string_builder__free(&console);
+}
@@ -0,0 +1,168 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <signal.h>
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
+#include <sys/eventfd.h>
+#include "loop.h"
+
+#define LOOP_SIGNAL_SLOT LOOP_MAX_WATCHES
+
+typedef struct {
+  int fd;
+  bool timer;
+  LoopHandler handler;
+  void* ctx;
+} LoopWatch;
+
+static struct {
+  int epfd;
+  int sigfd;
+  sigset_t signals;
+  LoopWatch watches[LOOP_MAX_WATCHES];
+  LoopSignalHandler on_signal[NSIG];
+} loop = {.epfd = -1, .sigfd = -1};
+
+/* Only runs while commands execute and the signal is unblocked; the child
+ * gets SIGINT itself and the shell just keeps waiting for it. */
+static void ignore_sigint(int sig) {
+  (void)sig;
+}
+
+bool loop_init(void) {
+  sigemptyset(&loop.signals);
+  sigaddset(&loop.signals, SIGINT);
+  sigaddset(&loop.signals, SIGCHLD);
+  sigaddset(&loop.signals, SIGWINCH);
+
+  struct sigaction sa = {0};
+  sa.sa_handler = ignore_sigint;
+  sa.sa_flags = SA_RESTART;
+  if (sigaction(SIGINT, &sa, NULL) == -1) {
+    perror("Error setting up signal handler");
+    return false;
+  }
+  if (pthread_sigmask(SIG_BLOCK, &loop.signals, NULL) != 0) return false;
+
+  for (int i = 0; i < LOOP_MAX_WATCHES; i++) loop.watches[i].fd = -1;
+  loop.epfd = epoll_create1(EPOLL_CLOEXEC);
+  loop.sigfd = signalfd(-1, &loop.signals, SFD_NONBLOCK | SFD_CLOEXEC);
+  if (loop.epfd == -1 || loop.sigfd == -1) {
+    perror("Error setting up event loop");
+    return false;
+  }
+  struct epoll_event ev = {.events = EPOLLIN, .data.u32 = LOOP_SIGNAL_SLOT};
+  return epoll_ctl(loop.epfd, EPOLL_CTL_ADD, loop.sigfd, &ev) == 0;
+}
+
+static bool loop_add(int fd, bool timer, LoopHandler handler, void* ctx) {
+  if (fd < 0 || loop.epfd == -1) return false;
+  for (uint32_t i = 0; i < LOOP_MAX_WATCHES; i++) {
+    if (loop.watches[i].fd != -1) continue;
+    struct epoll_event ev = {.events = EPOLLIN, .data.u32 = i};
+    if (epoll_ctl(loop.epfd, EPOLL_CTL_ADD, fd, &ev) != 0) return false;
+    loop.watches[i] = (LoopWatch){.fd = fd, .timer = timer, .handler = handler, .ctx = ctx};
+    return true;
+  }
+  return false;
+}
+
+bool loop_watch(int fd, LoopHandler handler, void* ctx) {
+  return loop_add(fd, false, handler, ctx);
+}
+
+void loop_unwatch(int fd) {
+  for (int i = 0; i < LOOP_MAX_WATCHES; i++) {
+    if (loop.watches[i].fd != fd) continue;
+    epoll_ctl(loop.epfd, EPOLL_CTL_DEL, fd, NULL);
+    loop.watches[i].fd = -1;
+  }
+}
+
+int loop_timer_new(LoopHandler handler, void* ctx) {
+  int fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  if (fd != -1 && !loop_add(fd, true, handler, ctx)) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+void loop_timer_arm(int fd, long long delay_ms) {
+  if (fd < 0) return;
+  struct itimerspec its = {0};
+  its.it_value.tv_sec = (time_t)(delay_ms / 1000);
+  its.it_value.tv_nsec = (long)(delay_ms % 1000) * 1000000L;
+  timerfd_settime(fd, 0, &its, NULL);
+}
+
+int loop_event_new(void) {
+  return eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+}
+
+/* Safe to call from worker threads. */
+void loop_event_signal(int fd) {
+  if (fd < 0) return;
+  uint64_t one = 1;
+  while (write(fd, &one, sizeof(one)) == -1 && errno == EINTR);
+}
+
+void loop_event_drain(int fd) {
+  uint64_t count;
+  while (read(fd, &count, sizeof(count)) == -1 && errno == EINTR);
+}
+
+void loop_on_signal(int signo, LoopSignalHandler handler) {
+  if (signo > 0 && signo < NSIG) loop.on_signal[signo] = handler;
+}
+
+void loop_enter(void) {
+  pthread_sigmask(SIG_BLOCK, &loop.signals, NULL);
+}
+
+void loop_leave(void) {
+  pthread_sigmask(SIG_UNBLOCK, &loop.signals, NULL);
+}
+
+static void loop_dispatch_signals(void) {
+  struct signalfd_siginfo info;
+  while (read(loop.sigfd, &info, sizeof(info)) == (ssize_t)sizeof(info)) {
+    int signo = (int)info.ssi_signo;
+    if (signo > 0 && signo < NSIG && loop.on_signal[signo] != NULL) loop.on_signal[signo](signo);
+  }
+}
+
+int loop_run_once(int timeout_ms) {
+  struct epoll_event events[LOOP_MAX_WATCHES + 1];
+  int n = epoll_wait(loop.epfd, events, LOOP_MAX_WATCHES + 1, timeout_ms);
+  if (n < 0) return errno == EINTR ? 0 : -1;
+  for (int i = 0; i < n; i++) {
+    uint32_t slot = events[i].data.u32;
+    if (slot == LOOP_SIGNAL_SLOT) {
+      loop_dispatch_signals();
+      continue;
+    }
+    LoopWatch* watch = &loop.watches[slot];
+    if (watch->fd == -1) continue;
+    if (watch->timer) loop_event_drain(watch->fd);
+    watch->handler(watch->ctx);
+  }
+  return n;
+}
+
+void loop_free(void) {
+  for (int i = 0; i < LOOP_MAX_WATCHES; i++) {
+    if (loop.watches[i].fd != -1 && loop.watches[i].timer) close(loop.watches[i].fd);
+    loop.watches[i].fd = -1;
+  }
+  if (loop.sigfd != -1) close(loop.sigfd);
+  if (loop.epfd != -1) close(loop.epfd);
+  loop.sigfd = loop.epfd = -1;
+}
@@ -8,6 +8,7 @@
 #include <limits.h>
 #include <pwd.h>
 #include <locale.h>
+#include <fcntl.h>
 #include <readline/readline.h>
 #include "rick.h"
 #include "result.h"
@@ -23,6 +24,9 @@
 #include "variable.h"
 #include "io.h"
 #include "history.h"
+#include "trace.h"
+#include "script.h"
+#include "profile.h"
 
 #define INITIAL_BUFFER_SIZE (1 * 1024)  // 1 KB initial size
 #define MAX_BUFFER_SIZE (100 * 1024 * 1024)  // 100 MB limit
@@ -34,13 +38,21 @@ extern bool do_not_save_history;
 
 volatile sig_atomic_t keep_running = 1;
 volatile int last_status = 0;
+bool interactive = false;
 
 static IntResult process_command(const string input) {
-  NTRY(parse_and_execute(input, (int*)&last_status));
+  TRACE_BEGIN(command_start);
+  int status = last_status;
+  Result r = parse_and_execute(input, &status);
+  /* `exit` stores its status itself and returns 0 like any builtin. */
+  if (keep_running) last_status = status;
+  TRACE_END(command_start, "command");
+  NTRY(r);
   return Ok(NULL);
 }
 
-int main(void) {
+static void run_interactive(void) {
+  interactive = true;
   init_rickshell();
   log_info("Shell started");
 
@@ -50,7 +62,7 @@ int main(void) {
 
     if (string__is_null_or_empty(input)) {
       string__free(input);
-      if (feof(stdin)) {
+      if (feof(stdin) || input_at_eof()) {
         println(_SLIT0);
         println(_SLIT("exit"));
         break;
@@ -76,6 +88,54 @@ int main(void) {
   }
   
   cleanup_rickshell();
+}
 
+static void run_script(ScriptReader* reader, const char* name) {
+  init_rickshell_noninteractive();
+  string statement;
+  size_t line;
+  while (keep_running && script_reader_next(reader, &statement, &line)) {
+    Result result = process_command(statement);
+    if (result.is_err)
+      ffprintln(stderr, "rickshell: %s: line %zu: %S", name, line, result.err.msg);
+    yylex_destroy();
+  }
+  cleanup_rickshell_noninteractive();
+}
+
+int main(int argc, char** argv) {
+  ScriptReader reader;
+  if (argc > 1 && strcmp(argv[1], "--startup-profile") == 0) {
+    startup_profile_enable();
+    run_interactive();
+    return last_status;
+  } else if (argc > 1 && strcmp(argv[1], "-c") == 0) {
+    if (argc < 3) {
+      ffprintln(stderr, "rickshell: -c: option requires an argument");
+      return 2;
+    }
+    script_reader_init_text(&reader, argv[2], strlen(argv[2]));
+    run_script(&reader, "-c");
+  } else if (argc > 1 && argv[1][0] == '-') {
+    ffprintln(stderr, "rickshell: %s: invalid option", argv[1]);
+    ffprintln(stderr, "usage: rickshell [--startup-profile | -c command | script]");
+    return 2;
+  } else if (argc > 1) {
+    int fd = open(argv[1], O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+      ffprintln(stderr, "rickshell: %s: %s", argv[1], strerror(errno));
+      return errno == ENOENT ? 127 : 126;
+    }
+    script_reader_init_fd(&reader, fd);
+    run_script(&reader, argv[1]);
+    close(fd);
+  } else if (!isatty(STDIN_FILENO)) {
+    script_reader_init_fd(&reader, STDIN_FILENO);
+    run_script(&reader, "stdin");
+  } else {
+    run_interactive();
+    return last_status;
+  }
+  script_reader_free(&reader);
   return last_status;
 }
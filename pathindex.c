@@ -0,0 +1,395 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include "pathindex.h"
+#include "memory.h"
+#include "file.h"
+#include "io.h"
+#include "profile.h"
+
+#define PATHINDEX_DENTS_BUFFER (32 * 1024)
+#define PATHINDEX_CACHE_MAGIC "RICKPATH 2"
+
+extern char *path_dirs[MAX_PATH_DIRS];
+extern int path_dir_count;
+
+typedef struct {
+  struct timespec mtime;
+  time_t scanned_at;
+  bool scanned;
+  char* names;
+  size_t names_len;
+} PathDir;
+
+typedef struct {
+  uint64_t hash;
+  const char* name;
+  size_t len;
+} PathSlot;
+
+static struct {
+  char* cache_path;
+  char* path_env;
+  PathDir dirs[MAX_PATH_DIRS];
+  PathSlot* slots;
+  size_t slot_mask;
+  const char** sorted;
+  size_t sorted_len;
+  unsigned long generation;
+  bool dirty;
+  pthread_t loader;
+  bool loading;
+} pindex;
+
+static uint64_t path_index_hash(const char* s, size_t len) {
+  uint64_t h = 14695981039346656037ULL;
+  for (size_t i = 0; i < len; i++) {
+    h ^= (unsigned char)s[i];
+    h *= 1099511628211ULL;
+  }
+  return h;
+}
+
+/* Like dircache.c, a directory changed in the second it was read may have
+ * changed after the read without moving its mtime, so it stays stale until
+ * a later scan. */
+static bool path_index_fresh(const PathDir* dir, const struct stat* st) {
+  return dir->scanned && dir->mtime.tv_sec == st->st_mtim.tv_sec && dir->mtime.tv_nsec == st->st_mtim.tv_nsec &&
+         dir->mtime.tv_sec < dir->scanned_at;
+}
+
+/* Reads the directory once with getdents64 and keeps the executable names as
+ * one NUL-separated block. */
+static void path_index_scan(PathDir* dir, const char* path, struct timespec mtime) {
+  rfree(dir->names);
+  dir->names = NULL;
+  dir->names_len = 0;
+  dir->mtime = mtime;
+  dir->scanned_at = time(NULL);
+  dir->scanned = true;
+  pindex.dirty = true;
+
+  int fd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (fd == -1) return;
+
+  StringBuilder names = string_builder__new();
+  char* buf = rmalloc(PATHINDEX_DENTS_BUFFER);
+  ssize_t n;
+  while ((n = getdents64(fd, buf, PATHINDEX_DENTS_BUFFER)) > 0) {
+    for (ssize_t off = 0; off < n;) {
+      struct dirent64* d = (struct dirent64*)(buf + off);
+      off += d->d_reclen;
+      if (d->d_name[0] == '.' || strchr(d->d_name, '\n') != NULL) continue;
+      if (d->d_type != DT_REG && d->d_type != DT_LNK && d->d_type != DT_UNKNOWN) continue;
+      struct stat st;
+      if (fstatat(fd, d->d_name, &st, 0) != 0 || !S_ISREG(st.st_mode) ||
+          faccessat(fd, d->d_name, X_OK, AT_EACCESS) != 0) continue;
+      string_builder__append_cstr(&names, d->d_name);
+      string_builder__append(&names, _SLIT("\0"));
+    }
+  }
+  rfree(buf);
+  close(fd);
+
+  if (names.len > 0) {
+    dir->names = rmalloc(names.len);
+    memcpy(dir->names, names.buffer, names.len);
+    dir->names_len = names.len;
+  }
+  string_builder__free(&names);
+}
+
+static int path_index_compare_names(const void* a, const void* b) {
+  return strcmp(*(const char* const*)a, *(const char* const*)b);
+}
+
+static void path_index_rebuild(void) {
+  size_t total = 0;
+  for (int i = 0; i < path_dir_count; i++)
+    for (size_t off = 0; off < pindex.dirs[i].names_len; off += strlen(pindex.dirs[i].names + off) + 1)
+      total++;
+
+  size_t capacity = 256;
+  while (capacity < total * 2) capacity <<= 1;
+  rfree(pindex.slots);
+  pindex.slots = rcalloc(capacity, sizeof(PathSlot));
+  pindex.slot_mask = capacity - 1;
+
+  for (int i = 0; i < path_dir_count; i++) {
+    const PathDir* dir = &pindex.dirs[i];
+    for (size_t off = 0; off < dir->names_len;) {
+      const char* name = dir->names + off;
+      size_t len = strlen(name);
+      off += len + 1;
+      uint64_t h = path_index_hash(name, len);
+      size_t j = (size_t)h & pindex.slot_mask;
+      while (pindex.slots[j].name != NULL &&
+             !(pindex.slots[j].hash == h && pindex.slots[j].len == len && memcmp(pindex.slots[j].name, name, len) == 0))
+        j = (j + 1) & pindex.slot_mask;
+      pindex.slots[j] = (PathSlot){.hash = h, .name = name, .len = len};
+    }
+  }
+
+  rfree(pindex.sorted);
+  pindex.sorted = rmalloc((total + 1) * sizeof(const char*));
+  pindex.sorted_len = 0;
+  for (size_t j = 0; j <= pindex.slot_mask; j++)
+    if (pindex.slots[j].name != NULL) pindex.sorted[pindex.sorted_len++] = pindex.slots[j].name;
+  qsort(pindex.sorted, pindex.sorted_len, sizeof(const char*), path_index_compare_names);
+  pindex.generation++;
+}
+
+static void path_index_load_cache(void) {
+  FILE* fp = fopen(pindex.cache_path, "r");
+  if (fp == NULL) return;
+
+  char* line = NULL;
+  size_t cap = 0;
+  ssize_t len = getline(&line, &cap, fp);
+  if (len <= 0 || strncmp(line, PATHINDEX_CACHE_MAGIC, sizeof(PATHINDEX_CACHE_MAGIC) - 1) != 0) {
+    free(line);
+    fclose(fp);
+    return;
+  }
+
+  PathDir* dir = NULL;
+  StringBuilder names = string_builder__new();
+  for (;;) {
+    len = getline(&line, &cap, fp);
+    bool header = len > 0 && line[0] == 'D' && line[1] == ' ';
+    if ((len <= 0 || header) && dir != NULL) {
+      dir->names = names.len ? rmalloc(names.len) : NULL;
+      if (names.len) memcpy(dir->names, names.buffer, names.len);
+      dir->names_len = names.len;
+      dir->scanned = true;
+      names.len = 0;
+      dir = NULL;
+    }
+    if (len <= 0) break;
+    if (line[len - 1] == '\n') line[--len] = '\0';
+
+    if (header) {
+      long long sec, nsec, scanned_at;
+      int consumed = 0;
+      if (sscanf(line + 2, "%lld %lld %lld %n", &sec, &nsec, &scanned_at, &consumed) != 3) continue;
+      const char* path = line + 2 + consumed;
+      for (int i = 0; i < path_dir_count; i++) {
+        if (!pindex.dirs[i].scanned && strcmp(path_dirs[i], path) == 0) {
+          dir = &pindex.dirs[i];
+          dir->mtime = (struct timespec){.tv_sec = (time_t)sec, .tv_nsec = (long)nsec};
+          dir->scanned_at = (time_t)scanned_at;
+          break;
+        }
+      }
+    } else if (dir != NULL && len > 0) {
+      string_builder__append_cstr(&names, line);
+      string_builder__append(&names, _SLIT("\0"));
+    }
+  }
+  string_builder__free(&names);
+  free(line);
+  fclose(fp);
+}
+
+static void path_index_save_cache(void) {
+  if (pindex.cache_path == NULL || !pindex.dirty) return;
+
+  StringBuilder sb = string_builder__new();
+  string_builder__append_cstr(&sb, PATHINDEX_CACHE_MAGIC "\n");
+  for (int i = 0; i < path_dir_count; i++) {
+    const PathDir* dir = &pindex.dirs[i];
+    if (!dir->scanned) continue;
+    string_builder__append_cstr(&sb, "D ");
+    string_builder__append_long_long(&sb, (long long)dir->mtime.tv_sec);
+    string_builder__append_cstr(&sb, " ");
+    string_builder__append_long_long(&sb, (long long)dir->mtime.tv_nsec);
+    string_builder__append_cstr(&sb, " ");
+    string_builder__append_long_long(&sb, (long long)dir->scanned_at);
+    string_builder__append_cstr(&sb, " ");
+    string_builder__append_cstr(&sb, path_dirs[i]);
+    string_builder__append_cstr(&sb, "\n");
+    for (size_t off = 0; off < dir->names_len;) {
+      const char* name = dir->names + off;
+      off += strlen(name) + 1;
+      string_builder__append_cstr(&sb, name);
+      string_builder__append_cstr(&sb, "\n");
+    }
+  }
+
+  size_t path_len = strlen(pindex.cache_path);
+  char* tmp = rmalloc(path_len + sizeof(".tmp"));
+  memcpy(tmp, pindex.cache_path, path_len);
+  memcpy(tmp + path_len, ".tmp", sizeof(".tmp"));
+  int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+  if (fd != -1) {
+    bool ok = _write(fd, sb.buffer, sb.len) == (ssize_t)sb.len;
+    ok = close(fd) == 0 && ok;
+    if (!ok || rename(tmp, pindex.cache_path) != 0) unlink(tmp);
+    else pindex.dirty = false;
+  }
+  rfree(tmp);
+  string_builder__free(&sb);
+}
+
+/* One stat per PATH directory; only directories whose mtime moved are read
+ * again. */
+static void path_index_update(bool changed) {
+  if (pindex.slots == NULL) changed = true;
+  for (int i = 0; i < path_dir_count; i++) {
+    struct stat st;
+    PathDir* dir = &pindex.dirs[i];
+    if (stat(path_dirs[i], &st) != 0) {
+      if (dir->names_len > 0 || !dir->scanned) {
+        rfree(dir->names);
+        dir->names = NULL;
+        dir->names_len = 0;
+        dir->scanned = true;
+        changed = true;
+      }
+      continue;
+    }
+    if (path_index_fresh(dir, &st)) continue;
+    path_index_scan(dir, path_dirs[i], st.st_mtim);
+    changed = true;
+  }
+  if (changed) path_index_rebuild();
+}
+
+/* Re-parses the directory list once $PATH changed, keeping what is known
+ * about directories that are still in it. Main thread only: the loader
+ * never reads the environment, which `export` may be changing. */
+static bool path_index_follow_path(void) {
+  const char* path = getenv("PATH");
+  if (path == NULL) path = "";
+  if (pindex.path_env != NULL && strcmp(pindex.path_env, path) == 0) return false;
+  rfree(pindex.path_env);
+  pindex.path_env = rstrdup(path);
+
+  PathDir old[MAX_PATH_DIRS];
+  char* old_paths[MAX_PATH_DIRS];
+  int old_count = path_dir_count;
+  memcpy(old, pindex.dirs, sizeof(old));
+  for (int i = 0; i < old_count; i++) old_paths[i] = rstrdup(path_dirs[i]);
+  parse_path();
+
+  memset(pindex.dirs, 0, sizeof(pindex.dirs));
+  for (int i = 0; i < path_dir_count; i++) {
+    for (int j = 0; j < old_count; j++) {
+      if (old_paths[j] == NULL || strcmp(old_paths[j], path_dirs[i]) != 0) continue;
+      pindex.dirs[i] = old[j];
+      old[j].names = NULL;
+      rfree(old_paths[j]);
+      old_paths[j] = NULL;
+      break;
+    }
+  }
+  for (int j = 0; j < old_count; j++) {
+    rfree(old[j].names);
+    rfree(old_paths[j]);
+  }
+  pindex.dirty = true;
+  return true;
+}
+
+static void* path_index_load(void* arg) {
+  (void)arg;
+  long long start = startup_clock_ns();
+  if (pindex.cache_path != NULL) path_index_load_cache();
+  path_index_update(false);
+  path_index_save_cache();
+  startup_background_phase("path index", start);
+  return NULL;
+}
+
+static void path_index_wait(void) {
+  if (!pindex.loading) return;
+  pthread_join(pindex.loader, NULL);
+  pindex.loading = false;
+}
+
+/* Every query first waits for the loader, which by the first keystroke has
+ * normally finished, and picks up a changed $PATH. */
+static void path_index_sync(void) {
+  path_index_wait();
+  if (path_index_follow_path()) path_index_update(true);
+}
+
+/* Called once per prompt rather than per keystroke. While the initial load
+ * runs there is nothing to do: it reads the directories as they are now. */
+void path_index_refresh(void) {
+  if (pindex.loading) return;
+  path_index_update(path_index_follow_path());
+}
+
+void path_index_rescan_dir(const char* dir, size_t len) {
+  for (int i = 0; i < path_dir_count; i++) {
+    if (strlen(path_dirs[i]) == len && memcmp(path_dirs[i], dir, len) == 0) pindex.dirs[i].scanned = false;
+  }
+}
+
+void path_index_init(const char* cache_path) {
+  path_index_free();
+  pindex.cache_path = expand_home_directory(cache_path);
+  const char* path = getenv("PATH");
+  pindex.path_env = rstrdup(path != NULL ? path : "");
+  pindex.loading = pthread_create(&pindex.loader, NULL, path_index_load, NULL) == 0;
+  if (!pindex.loading) path_index_load(NULL);
+}
+
+bool path_index_contains(const string name) {
+  path_index_sync();
+  if (pindex.slots == NULL || name.len == 0) return false;
+  uint64_t h = path_index_hash(name.str, name.len);
+  for (size_t j = (size_t)h & pindex.slot_mask; pindex.slots[j].name != NULL; j = (j + 1) & pindex.slot_mask) {
+    const PathSlot* slot = &pindex.slots[j];
+    if (slot->hash == h && slot->len == name.len && memcmp(slot->name, name.str, name.len) == 0) return true;
+  }
+  return false;
+}
+
+size_t path_index_find_prefix(const char* prefix, size_t len, size_t* first) {
+  path_index_sync();
+  size_t lo = 0, hi = pindex.sorted_len;
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    if (strncmp(pindex.sorted[mid], prefix, len) < 0) lo = mid + 1;
+    else hi = mid;
+  }
+  size_t end = lo;
+  while (end < pindex.sorted_len && strncmp(pindex.sorted[end], prefix, len) == 0) end++;
+  *first = lo;
+  return end - lo;
+}
+
+const char* path_index_name_at(size_t pos) {
+  path_index_sync();
+  return pos < pindex.sorted_len ? pindex.sorted[pos] : NULL;
+}
+
+size_t path_index_count(void) {
+  path_index_sync();
+  return pindex.sorted_len;
+}
+
+unsigned long path_index_generation(void) {
+  path_index_sync();
+  return pindex.generation;
+}
+
+void path_index_free(void) {
+  path_index_wait();
+  path_index_save_cache();
+  for (int i = 0; i < MAX_PATH_DIRS; i++) rfree(pindex.dirs[i].names);
+  rfree(pindex.slots);
+  rfree(pindex.sorted);
+  rfree(pindex.cache_path);
+  rfree(pindex.path_env);
+  memset(&pindex, 0, sizeof(pindex));
+}
@@ -0,0 +1,331 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <poll.h>
+#include <termios.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include "picker.h"
+#include "histstore.h"
+#include "memory.h"
+#include "io.h"
+
+#define CTRL_KEY(k) ((k) & 0x1f)
+
+static uint64_t picker_hash(const char* s, size_t len) {
+  uint64_t h = 14695981039346656037ULL;
+  for (size_t i = 0; i < len; i++) {
+    h ^= (unsigned char)s[i];
+    h *= 1099511628211ULL;
+  }
+  return h;
+}
+
+size_t picker_load_history(FuzzySet* set) {
+  size_t count = history_store_count();
+  size_t capacity = 16;
+  while (capacity < count * 2) capacity *= 2;
+  uint32_t* seen = rcalloc(capacity, sizeof(uint32_t));
+
+  for (size_t i = count; i-- > 0;) {
+    string line = history_store_get(i);
+    if (line.len == 0) continue;
+    size_t slot = (size_t)picker_hash(line.str, line.len) & (capacity - 1);
+    bool duplicate = false;
+    for (; seen[slot] != 0; slot = (slot + 1) & (capacity - 1)) {
+      string other = fuzzy_set_get(set, seen[slot] - 1);
+      if (other.len == line.len && memcmp(other.str, line.str, line.len) == 0) {
+        duplicate = true;
+        break;
+      }
+    }
+    if (duplicate) continue;
+    seen[slot] = (uint32_t)set->count + 1;
+    fuzzy_set_add(set, line.str, line.len);
+  }
+  rfree(seen);
+  return set->count;
+}
+
+static bool is_directory(DIR* dir, const struct dirent* ent) {
+  if (ent->d_type != DT_UNKNOWN) return ent->d_type == DT_DIR;
+  struct stat st;
+  return fstatat(dirfd(dir), ent->d_name, &st, AT_SYMLINK_NOFOLLOW) == 0 && S_ISDIR(st.st_mode);
+}
+
+/* Directories still to be read are queued as NUL-separated paths relative
+ * to the root; symlinks to directories are listed like files, not entered. */
+size_t picker_load_files(FuzzySet* set, const char* root, int what) {
+  bool here = strcmp(root, ".") == 0;
+  StringBuilder queue = string_builder__new();
+  StringBuilder path = string_builder__new();
+  size_t next = 0;
+  string_builder__append_cstr(&queue, here ? "" : root);
+  string_builder__append_char(&queue, '\0');
+
+  while (next < queue.len && set->count < PICKER_MAX_FILES) {
+    const char* rel = queue.buffer + next;
+    size_t rel_len = strlen(rel);
+    next += rel_len + 1;
+    DIR* dir = opendir(rel_len > 0 ? rel : ".");
+    if (dir == NULL) continue;
+    path.len = 0;
+    string_builder__append_cstr(&path, rel);
+    if (rel_len > 0 && path.buffer[rel_len - 1] != '/') string_builder__append_char(&path, '/');
+    size_t base = path.len;
+
+    struct dirent* ent;
+    while ((ent = readdir(dir)) != NULL && set->count < PICKER_MAX_FILES) {
+      if (ent->d_name[0] == '.') continue;
+      path.len = base;
+      string_builder__append_cstr(&path, ent->d_name);
+      bool is_dir = is_directory(dir, ent);
+      if (what & (is_dir ? PICKER_WALK_DIRS : PICKER_WALK_FILES)) fuzzy_set_add(set, path.buffer, path.len);
+      if (is_dir) {
+        string_builder__append(&queue, (string){.str = path.buffer, .len = path.len, .is_lit = 1});
+        string_builder__append_char(&queue, '\0');
+      }
+    }
+    closedir(dir);
+  }
+  string_builder__free(&path);
+  string_builder__free(&queue);
+  return set->count;
+}
+
+size_t picker_load_lines(FuzzySet* set, int fd) {
+  StringBuilder buf = string_builder__with_capacity(PICKER_READ_CHUNK + 1);
+  for (;;) {
+    if (buf.capacity - buf.len < PICKER_READ_CHUNK + 1) {
+      buf.capacity = buf.capacity * 2 + PICKER_READ_CHUNK;
+      buf.buffer = rrealloc(buf.buffer, buf.capacity);
+    }
+    ssize_t n = read(fd, buf.buffer + buf.len, PICKER_READ_CHUNK);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) break;
+    size_t scanned = buf.len;
+    buf.len += (size_t)n;
+    size_t start = 0;
+    char* nl;
+    while ((nl = memchr(buf.buffer + scanned, '\n', buf.len - scanned)) != NULL) {
+      size_t end = (size_t)(nl - buf.buffer);
+      size_t len = end - start;
+      if (len > 0 && buf.buffer[end - 1] == '\r') len--;
+      if (len > 0) fuzzy_set_add(set, buf.buffer + start, len);
+      start = scanned = end + 1;
+    }
+    memmove(buf.buffer, buf.buffer + start, buf.len - start);
+    buf.len -= start;
+  }
+  if (buf.len > 0) fuzzy_set_add(set, buf.buffer, buf.len);
+  string_builder__free(&buf);
+  return set->count;
+}
+
+typedef struct {
+  int fd;
+  struct termios saved;
+  size_t rows;
+  size_t cols;
+  char query[FUZZY_MAX_QUERY + 1];
+  size_t query_len;
+  FuzzyMatch top[FUZZY_TOP_K];
+  size_t top_len;
+  size_t matched;
+  size_t selected;
+  size_t scroll;
+} Picker;
+
+static void put_cursor_up(StringBuilder* out, size_t rows) {
+  if (rows == 0) return;
+  string_builder__append_cstr(out, "\033[");
+  string_builder__append_long_long(out, (long long)rows);
+  string_builder__append_char(out, 'A');
+}
+
+/* Control characters would break the layout, and anything wider than the
+ * terminal is cut; columns are counted per UTF-8 lead byte. */
+static void put_candidate(StringBuilder* out, const Picker* p, const string text, bool selected) {
+  size_t positions[FUZZY_MAX_QUERY];
+  size_t hits = fuzzy_positions(text, p->query, positions, FUZZY_MAX_QUERY);
+  size_t next = 0, cols = 2;
+  string_builder__append_cstr(out, selected ? "\033[7m> " : "  ");
+  for (size_t i = 0; i < text.len; i++) {
+    unsigned char c = (unsigned char)text.str[i];
+    if ((c & 0xC0) != 0x80 && ++cols > p->cols) break;
+    bool hit = next < hits && positions[next] == i;
+    if (hit) {
+      next++;
+      string_builder__append_cstr(out, "\033[1;32m");
+    }
+    string_builder__append_char(out, c < 0x20 || c == 0x7f ? ' ' : (char)c);
+    if (hit) string_builder__append_cstr(out, selected ? "\033[22;39m" : "\033[0m");
+  }
+  if (selected) string_builder__append_cstr(out, "\033[0m");
+}
+
+static void picker_draw(const Picker* p, const FuzzySet* set) {
+  StringBuilder out = string_builder__new();
+  string_builder__append_cstr(&out, "\033[?2026h\r\033[J> ");
+  string_builder__append(&out, (string){.str = (char*)p->query, .len = p->query_len, .is_lit = 1});
+  string_builder__append_cstr(&out, "  \033[2m");
+  string_builder__append_long_long(&out, (long long)p->matched);
+  string_builder__append_char(&out, '/');
+  string_builder__append_long_long(&out, (long long)set->count);
+  string_builder__append_cstr(&out, "\033[0m");
+  for (size_t row = 0; row < p->rows; row++) {
+    string_builder__append_cstr(&out, "\r\n");
+    size_t i = p->scroll + row;
+    if (i < p->top_len) put_candidate(&out, p, fuzzy_set_get(set, p->top[i].index), i == p->selected);
+  }
+  put_cursor_up(&out, p->rows);
+  string_builder__append_cstr(&out, "\r\033[");
+  string_builder__append_long_long(&out, (long long)(p->query_len + 3));
+  string_builder__append_cstr(&out, "G\033[?2026l");
+  _write(p->fd, out.buffer, out.len);
+  string_builder__free(&out);
+}
+
+static bool picker_open(Picker* p) {
+  p->fd = open("/dev/tty", O_RDWR | O_CLOEXEC);
+  if (p->fd == -1) return false;
+  if (tcgetattr(p->fd, &p->saved) == -1) {
+    close(p->fd);
+    return false;
+  }
+  struct termios raw = p->saved;
+  raw.c_lflag &= ~(tcflag_t)(ICANON | ECHO | ISIG | IEXTEN);
+  raw.c_iflag &= ~(tcflag_t)(ICRNL | IXON);
+  raw.c_cc[VMIN] = 1;
+  raw.c_cc[VTIME] = 0;
+  tcsetattr(p->fd, TCSANOW, &raw);
+
+  struct winsize ws;
+  size_t lines = 24;
+  p->cols = 80;
+  if (ioctl(p->fd, TIOCGWINSZ, &ws) == 0 && ws.ws_row > 0) {
+    lines = ws.ws_row;
+    p->cols = ws.ws_col;
+  }
+  p->rows = lines > PICKER_ROWS + 1 ? PICKER_ROWS : (lines > 1 ? lines - 1 : 0);
+
+  StringBuilder out = string_builder__new();
+  string_builder__append_char(&out, '\r');
+  for (size_t i = 0; i < p->rows; i++) string_builder__append_char(&out, '\n');
+  put_cursor_up(&out, p->rows);
+  _write(p->fd, out.buffer, out.len);
+  string_builder__free(&out);
+  return true;
+}
+
+static void picker_close(Picker* p) {
+  _write(p->fd, "\r\033[J", 4);
+  tcsetattr(p->fd, TCSANOW, &p->saved);
+  close(p->fd);
+}
+
+static void picker_search(Picker* p, FuzzySet* set) {
+  p->query[p->query_len] = '\0';
+  p->matched = fuzzy_search(set, p->query, p->top, FUZZY_TOP_K, &p->top_len);
+  p->selected = p->scroll = 0;
+}
+
+static void picker_move(Picker* p, long delta) {
+  if (p->top_len == 0) return;
+  long at = (long)p->selected + delta;
+  if (at < 0) at = 0;
+  if (at >= (long)p->top_len) at = (long)p->top_len - 1;
+  p->selected = (size_t)at;
+  if (p->selected < p->scroll) p->scroll = p->selected;
+  if (p->selected >= p->scroll + p->rows) p->scroll = p->selected - p->rows + 1;
+}
+
+typedef enum {
+  Picker_Continue,
+  Picker_Accept,
+  Picker_Cancel,
+} PickerAction;
+
+static bool more_input(int fd, int timeout_ms) {
+  struct pollfd pfd = {.fd = fd, .events = POLLIN};
+  return poll(&pfd, 1, timeout_ms) > 0;
+}
+
+/* Handles everything read in one go, so a burst of typeahead costs a single
+ * search and frame. A lone ESC only cancels if no sequence follows it. */
+static PickerAction picker_keys(Picker* p, const unsigned char* buf, size_t len, bool* edited) {
+  for (size_t i = 0; i < len; i++) {
+    unsigned char c = buf[i];
+    if (c == '\033') {
+      if (i + 1 == len) return Picker_Cancel;
+      i++;
+      if (buf[i] != '[' && buf[i] != 'O') continue;
+      while (i + 1 < len && buf[i + 1] >= 0x20 && buf[i + 1] < 0x40) i++;
+      if (++i == len) break;
+      if (buf[i] == 'A') picker_move(p, -1);
+      else if (buf[i] == 'B') picker_move(p, 1);
+    } else if (c == '\r' || c == '\n') {
+      return Picker_Accept;
+    } else if (c == CTRL_KEY('c') || c == CTRL_KEY('g')) {
+      return Picker_Cancel;
+    } else if (c == CTRL_KEY('p') || c == CTRL_KEY('k')) {
+      picker_move(p, -1);
+    } else if (c == CTRL_KEY('n') || c == CTRL_KEY('j')) {
+      picker_move(p, 1);
+    } else if (c == 127 || c == CTRL_KEY('h')) {
+      while (p->query_len > 0 && ((unsigned char)p->query[--p->query_len] & 0xC0) == 0x80);
+      *edited = true;
+    } else if (c == CTRL_KEY('u')) {
+      p->query_len = 0;
+      *edited = true;
+    } else if (c >= 0x20 && p->query_len < FUZZY_MAX_QUERY) {
+      p->query[p->query_len++] = (char)c;
+      *edited = true;
+    }
+  }
+  return Picker_Continue;
+}
+
+char* picker_run(FuzzySet* set, const char* query) {
+  Picker p = {0};
+  if (!picker_open(&p)) return NULL;
+  p.query_len = strnlen(query, FUZZY_MAX_QUERY);
+  memcpy(p.query, query, p.query_len);
+  picker_search(&p, set);
+
+  PickerAction action = Picker_Continue;
+  unsigned char buf[256];
+  while (action == Picker_Continue) {
+    picker_draw(&p, set);
+    ssize_t n = read(p.fd, buf, sizeof(buf) - 1);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) {
+      action = Picker_Cancel;
+      break;
+    }
+    size_t len = (size_t)n;
+    if (buf[len - 1] == '\033' && more_input(p.fd, PICKER_ESC_TIMEOUT_MS)) {
+      n = read(p.fd, buf + len, sizeof(buf) - 1 - len);
+      if (n > 0) len += (size_t)n;
+    }
+    bool edited = false;
+    action = picker_keys(&p, buf, len, &edited);
+    if (edited && action == Picker_Continue) picker_search(&p, set);
+  }
+
+  char* choice = NULL;
+  if (action == Picker_Accept && p.selected < p.top_len) {
+    string s = fuzzy_set_get(set, p.top[p.selected].index);
+    choice = rmalloc(s.len + 1);
+    memcpy(choice, s.str, s.len);
+    choice[s.len] = '\0';
+  }
+  picker_close(&p);
+  return choice;
+}
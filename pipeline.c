@@ -4,6 +4,7 @@
 #include <string.h>
 #include <sys/wait.h>
 #include <errno.h>
+#include <signal.h>
 #include "color.h"
 #include "expr.h"
 #include "execute.h"
@@ -11,6 +12,29 @@
 #include "pipeline.h"
 #include "rstring.h"
 #include "array.h"
+#include "builtin.h"
+
+/* Builtins with no program of the same name to exec, run in the stage's
+ * child instead. The rest exec as before, so echo and printf use the
+ * external programs and cd or exit cannot act in a child that discards
+ * them. */
+static const string pipeline_builtins[] = {_SLIT("fuzzy"), _SLIT("help"), _SLIT("history")};
+
+/* The child has no exec to reset the shell's SIGINT handler, so it is reset
+ * here to let Ctrl-C stop a builtin stage as it would an external one. */
+static void run_builtin_stage(Command* cmd) {
+  string name = *(string*)array_checked_get(cmd->argv, 0);
+  register size_t i;
+  for (i = 0; i < sizeof(pipeline_builtins) / sizeof(string); i++)
+    if (string__compare(name, pipeline_builtins[i]) == 0) break;
+  if (i == sizeof(pipeline_builtins) / sizeof(string)) return;
+
+  signal(SIGINT, SIG_DFL);
+  int code = execute_builtin(cmd);
+  if (code == -1) return;
+  fflush(stdout);
+  _exit(code);
+}
 
 IntResult execute_pipeline(Command* first_cmd, int* result) {
   int pipefd[2], error_pipe[2], status = 0;
@@ -43,6 +67,7 @@ IntResult execute_pipeline(Command* first_cmd, int* result) {
         dprintf(error_pipe[1], "Error: Failed to handle redirection\n");
         _exit(1);
       }
+      run_builtin_stage(cmd);
       rexecvp(*(string*)array_checked_get(cmd->argv, 0), cmd->argv);
       dprintf(error_pipe[1], ANSI_COLOR_BRIGHT_BOLD_RED "error:" ANSI_COLOR_RESET " %s\n", strerror(errno));
       exit(1);
@@ -72,6 +97,7 @@ IntResult execute_pipeline(Command* first_cmd, int* result) {
         dprintf(error_pipe[1], ANSI_COLOR_BRIGHT_BOLD_RED "error:" ANSI_COLOR_RESET "%s\n", r.err.msg.str);
         _exit(1);
       }
+      run_builtin_stage(cmd);
       rexecvp(*(string*)array_checked_get(cmd->argv, 0), cmd->argv);
       perror("execvp failed in pipeline");
       exit(1);
@@ -0,0 +1,260 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <errno.h>
+#include <limits.h>
+#include <elf.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include "prefetch.h"
+#include "builtin.h"
+#include "pathindex.h"
+#include "memory.h"
+#include "file.h"
+
+#define PREFETCH_HEADER 512
+#define PREFETCH_MAX_DEPTH 3
+#define PREFETCH_CHUNK (2 * 1024 * 1024)
+
+typedef struct {
+  dev_t dev;
+  ino_t ino;
+  time_t at;
+} PrefetchRecent;
+
+/* `request`, `search` and `due_ms` are shared with the worker under `lock`;
+ * `word` is only used by the main thread and `recent` only by the worker.
+ * The worker resolves against `search`, a copy of $PATH taken when the
+ * request was made, because the environment is not safe to read here. */
+static struct {
+  pthread_t worker;
+  bool worker_started;
+  pthread_mutex_t lock;
+  pthread_cond_t wake;
+  char* request;
+  char* search;
+  long long due_ms;
+  bool stop;
+  char word[PREFETCH_MAX_WORD];
+  size_t word_len;
+  PrefetchRecent recent[PREFETCH_RECENT];
+  size_t recent_next;
+} pf = {.lock = PTHREAD_MUTEX_INITIALIZER};
+
+static long long monotonic_ms(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static bool prefetch_enabled(void) {
+  const char* env = getenv("RICKSHELL_PREFETCH");
+  return env != NULL && env[0] != '\0' && strcmp(env, "0") != 0;
+}
+
+static bool seen_recently(const struct stat* st) {
+  time_t now = time(NULL);
+  for (size_t i = 0; i < PREFETCH_RECENT; i++) {
+    PrefetchRecent* r = &pf.recent[i];
+    if (r->at != 0 && r->dev == st->st_dev && r->ino == st->st_ino && now - r->at < PREFETCH_REPEAT_SECONDS) return true;
+  }
+  pf.recent[pf.recent_next] = (PrefetchRecent){.dev = st->st_dev, .ino = st->st_ino, .at = now};
+  pf.recent_next = (pf.recent_next + 1) % PREFETCH_RECENT;
+  return false;
+}
+
+static bool resolve_command(const char* name, const char* search, char* out, size_t size) {
+  if (strchr(name, '/') != NULL) {
+    snprintf(out, size, "%s", name);
+    return access(out, X_OK) == 0;
+  }
+  for (const char* dir = search; dir != NULL;) {
+    const char* end = strchr(dir, ':');
+    int dir_len = (int)(end != NULL ? (size_t)(end - dir) : strlen(dir));
+    int n = snprintf(out, size, "%.*s%s%s", dir_len, dir, dir_len > 0 ? "/" : "", name);
+    if (n > 0 && (size_t)n < size && access(out, X_OK) == 0) return true;
+    dir = end != NULL ? end + 1 : NULL;
+  }
+  return false;
+}
+
+static void warm_file(const char* path, const char* search, int depth);
+
+static void warm_elf_interpreter(int fd, const unsigned char* header, ssize_t got, const char* search, int depth) {
+  if (got < (ssize_t)sizeof(Elf64_Ehdr) || header[EI_CLASS] != ELFCLASS64) return;
+  Elf64_Ehdr eh;
+  memcpy(&eh, header, sizeof(eh));
+  if (eh.e_phentsize != sizeof(Elf64_Phdr) || eh.e_phnum == 0 || eh.e_phnum > 64) return;
+  Elf64_Phdr ph[64];
+  size_t bytes = (size_t)eh.e_phnum * sizeof(Elf64_Phdr);
+  if (pread(fd, ph, bytes, (off_t)eh.e_phoff) != (ssize_t)bytes) return;
+  for (size_t i = 0; i < eh.e_phnum; i++) {
+    if (ph[i].p_type != PT_INTERP || ph[i].p_filesz == 0 || ph[i].p_filesz >= PATH_MAX) continue;
+    char interp[PATH_MAX];
+    ssize_t n = pread(fd, interp, ph[i].p_filesz, (off_t)ph[i].p_offset);
+    if (n <= 0) return;
+    interp[n] = '\0';
+    warm_file(interp, search, depth + 1);
+    return;
+  }
+}
+
+/* "#!/usr/bin/env prog" warms prog from the PATH as well as env itself. */
+static void warm_script_interpreter(const unsigned char* header, ssize_t got, const char* search, int depth) {
+  char line[PREFETCH_HEADER];
+  size_t len = 0;
+  for (ssize_t i = 2; i < got && header[i] != '\n' && len + 1 < sizeof(line); i++) line[len++] = (char)header[i];
+  line[len] = '\0';
+  char* save = NULL;
+  char* interp = strtok_r(line, " \t", &save);
+  if (interp == NULL) return;
+  warm_file(interp, search, depth + 1);
+  const char* base = strrchr(interp, '/');
+  char* prog = strtok_r(NULL, " \t", &save);
+  if (prog != NULL && strcmp(base != NULL ? base + 1 : interp, "env") == 0) {
+    char path[PATH_MAX];
+    if (resolve_command(prog, search, path, sizeof(path))) warm_file(path, search, depth + 1);
+  }
+}
+
+/* POSIX_FADV_WILLNEED queues asynchronous readahead, but the kernel caps each
+ * call at the device's readahead window, so the file is covered in chunks.
+ * Only the header is read here, to find what else to warm. */
+static void warm_file(const char* path, const char* search, int depth) {
+  if (depth > PREFETCH_MAX_DEPTH) return;
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd == -1) return;
+  struct stat st;
+  if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || seen_recently(&st)) {
+    close(fd);
+    return;
+  }
+  off_t len = st.st_size < PREFETCH_MAX_BYTES ? st.st_size : (off_t)PREFETCH_MAX_BYTES;
+  for (off_t off = 0; off < len; off += PREFETCH_CHUNK)
+    posix_fadvise(fd, off, PREFETCH_CHUNK, POSIX_FADV_WILLNEED);
+
+  unsigned char header[PREFETCH_HEADER];
+  ssize_t got = pread(fd, header, sizeof(header), 0);
+  if (got >= 4 && memcmp(header, ELFMAG, SELFMAG) == 0) warm_elf_interpreter(fd, header, got, search, depth);
+  else if (got >= 2 && header[0] == '#' && header[1] == '!') warm_script_interpreter(header, got, search, depth);
+  close(fd);
+}
+
+/* A request only runs once it has stayed unchanged until `due_ms`, so typing
+ * through a word costs one wake-up per key and no I/O. */
+static void* prefetch_worker(void* arg) {
+  (void)arg;
+  pthread_mutex_lock(&pf.lock);
+  for (;;) {
+    while (pf.request == NULL && !pf.stop)
+      pthread_cond_wait(&pf.wake, &pf.lock);
+    if (pf.stop) break;
+    long long wait = pf.due_ms - monotonic_ms();
+    if (wait > 0) {
+      struct timespec until;
+      clock_gettime(CLOCK_MONOTONIC, &until);
+      until.tv_sec += (time_t)(wait / 1000);
+      until.tv_nsec += (long)(wait % 1000) * 1000000L;
+      if (until.tv_nsec >= 1000000000L) {
+        until.tv_sec++;
+        until.tv_nsec -= 1000000000L;
+      }
+      pthread_cond_timedwait(&pf.wake, &pf.lock, &until);
+      continue;
+    }
+    char* name = pf.request;
+    char* search = pf.search;
+    pf.request = NULL;
+    pf.search = NULL;
+    pthread_mutex_unlock(&pf.lock);
+
+    char path[PATH_MAX];
+    if (resolve_command(name, search, path, sizeof(path))) warm_file(path, search, 0);
+    rfree(name);
+    rfree(search);
+
+    pthread_mutex_lock(&pf.lock);
+  }
+  pthread_mutex_unlock(&pf.lock);
+  return NULL;
+}
+
+static bool start_worker(void) {
+  pthread_condattr_t attr;
+  pthread_condattr_init(&attr);
+  pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+  pthread_cond_init(&pf.wake, &attr);
+  pthread_condattr_destroy(&attr);
+  pf.worker_started = pthread_create(&pf.worker, NULL, prefetch_worker, NULL) == 0;
+  if (!pf.worker_started) pthread_cond_destroy(&pf.wake);
+  return pf.worker_started;
+}
+
+static void drop_request(void) {
+  if (!pf.worker_started) return;
+  pthread_mutex_lock(&pf.lock);
+  rfree(pf.request);
+  rfree(pf.search);
+  pf.request = NULL;
+  pf.search = NULL;
+  pthread_mutex_unlock(&pf.lock);
+}
+
+void prefetch_command(const char* line, size_t len) {
+  size_t start = 0;
+  while (start < len && (line[start] == ' ' || line[start] == '\t')) start++;
+  size_t end = start;
+  while (end < len && strchr(" \t\n;|&<>()", line[end]) == NULL) end++;
+  size_t word_len = end - start;
+  if (word_len == pf.word_len && memcmp(line + start, pf.word, word_len) == 0) return;
+  if (word_len >= PREFETCH_MAX_WORD) return;
+  memcpy(pf.word, line + start, word_len);
+  pf.word[word_len] = '\0';
+  pf.word_len = word_len;
+
+  string word = {.str = pf.word, .len = word_len, .is_lit = 1};
+  bool wanted = word_len > 0 && prefetch_enabled() && memchr(pf.word, '=', word_len) == NULL &&
+                (strchr(pf.word, '/') != NULL || (get_builtin_func(word) == NULL && path_index_contains(word)));
+  if (!wanted) {
+    drop_request();
+    return;
+  }
+
+  pthread_mutex_lock(&pf.lock);
+  if (pf.worker_started || start_worker()) {
+    const char* search = getenv("PATH");
+    rfree(pf.request);
+    rfree(pf.search);
+    pf.request = rstrdup(pf.word);
+    pf.search = rstrdup(search != NULL ? search : "/bin:/usr/bin");
+    pf.due_ms = monotonic_ms() + PREFETCH_DELAY_MS;
+    pthread_cond_signal(&pf.wake);
+  }
+  pthread_mutex_unlock(&pf.lock);
+}
+
+void prefetch_cancel(void) {
+  pf.word_len = 0;
+  drop_request();
+}
+
+void prefetch_free(void) {
+  if (pf.worker_started) {
+    pthread_mutex_lock(&pf.lock);
+    pf.stop = true;
+    pthread_cond_signal(&pf.wake);
+    pthread_mutex_unlock(&pf.lock);
+    pthread_join(pf.worker, NULL);
+    pthread_cond_destroy(&pf.wake);
+    pf.worker_started = false;
+  }
+  rfree(pf.request);
+  rfree(pf.search);
+  pf.request = NULL;
+  pf.search = NULL;
+}
@@ -0,0 +1,83 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include "profile.h"
+#include "io.h"
+
+typedef struct {
+  const char* name;
+  long long ns;
+  bool background;
+} StartupPhase;
+
+static struct {
+  bool enabled;
+  pthread_mutex_t lock;
+  long long origin_ns;
+  long long mark_ns;
+  long long first_prompt_ns;
+  StartupPhase phases[STARTUP_MAX_PHASES];
+  size_t count;
+} profile = {.lock = PTHREAD_MUTEX_INITIALIZER};
+
+long long startup_clock_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+void startup_profile_enable(void) {
+  profile.enabled = true;
+  profile.origin_ns = startup_clock_ns();
+  profile.mark_ns = profile.origin_ns;
+}
+
+bool startup_profile_enabled(void) {
+  return profile.enabled;
+}
+
+static void add_phase(const char* name, long long ns, bool background) {
+  pthread_mutex_lock(&profile.lock);
+  if (profile.count < STARTUP_MAX_PHASES)
+    profile.phases[profile.count++] = (StartupPhase){.name = name, .ns = ns, .background = background};
+  pthread_mutex_unlock(&profile.lock);
+}
+
+void startup_phase(const char* name) {
+  if (!profile.enabled) return;
+  long long now = startup_clock_ns();
+  add_phase(name, now - profile.mark_ns, false);
+  profile.mark_ns = now;
+}
+
+void startup_background_phase(const char* name, long long start_ns) {
+  if (!profile.enabled) return;
+  add_phase(name, startup_clock_ns() - start_ns, true);
+}
+
+void startup_first_prompt(void) {
+  if (!profile.enabled || profile.first_prompt_ns != 0) return;
+  profile.first_prompt_ns = startup_clock_ns();
+}
+
+void startup_profile_report(void) {
+  if (!profile.enabled) return;
+  char row[96];
+  pthread_mutex_lock(&profile.lock);
+  ffprintln(stderr, "startup profile:");
+  for (size_t i = 0; i < profile.count; i++) {
+    const StartupPhase* phase = &profile.phases[i];
+    snprintf(row, sizeof(row), "  %-24s %9.3f ms%s", phase->name, (double)phase->ns / 1e6,
+             phase->background ? "  (background)" : "");
+    ffprintln(stderr, "%s", row);
+  }
+  if (profile.first_prompt_ns != 0) {
+    snprintf(row, sizeof(row), "  %-24s %9.3f ms", "first prompt",
+             (double)(profile.first_prompt_ns - profile.origin_ns) / 1e6);
+    ffprintln(stderr, "%s", row);
+  }
+  pthread_mutex_unlock(&profile.lock);
+}
@@ -0,0 +1,293 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <limits.h>
+#include <pwd.h>
+#include "prompt.h"
+#include "variable.h"
+#include "memory.h"
+#include "gitstatus.h"
+
+extern VariableTable* variable_table;
+
+typedef enum {
+  Segment_Literal,
+  Segment_User,
+  Segment_Host,
+  Segment_HostShort,
+  Segment_Cwd,
+  Segment_CwdBase,
+  Segment_Vcs
+} PromptSegmentKind;
+
+typedef struct {
+  PromptSegmentKind kind;
+  size_t start;
+  size_t len;
+  bool hidden;
+} PromptSegment;
+
+/* The PS1 template is compiled into segments once; each segment's value is
+ * cached until its own trigger fires (cd for the cwd, a PS1 assignment for
+ * the template), so an unchanged prompt is returned without any syscalls. */
+static struct {
+  char* source;
+  StringBuilder literals;
+  PromptSegment* segments;
+  size_t count;
+  size_t capacity;
+  bool template_valid;
+  bool uses_vcs;
+  char* user;
+  char* host;
+  bool identity_loaded;
+  char* cwd;
+  char* cwd_display;
+  bool cwd_valid;
+  string rendered;
+  size_t width;
+  bool rendered_valid;
+} pcache;
+
+static void push_segment(PromptSegmentKind kind, bool hidden) {
+  if (pcache.count == pcache.capacity) {
+    pcache.capacity = pcache.capacity ? pcache.capacity * 2 : 16;
+    pcache.segments = rrealloc(pcache.segments, pcache.capacity * sizeof(PromptSegment));
+  }
+  pcache.segments[pcache.count++] = (PromptSegment){.kind = kind, .start = pcache.literals.len, .len = 0, .hidden = hidden};
+}
+
+static void push_literal(char c, bool hidden) {
+  PromptSegment* last = pcache.count > 0 ? &pcache.segments[pcache.count - 1] : NULL;
+  if (last == NULL || last->kind != Segment_Literal || last->hidden != hidden)
+    push_segment(Segment_Literal, hidden);
+  string_builder__append_char(&pcache.literals, c);
+  pcache.segments[pcache.count - 1].len++;
+}
+
+static void compile_template(const char* ps1) {
+  pcache.count = 0;
+  pcache.literals.len = 0;
+  pcache.uses_vcs = false;
+  bool hidden = false;
+  for (const char* p = ps1; *p != '\0'; p++) {
+    if (*p != '\\' || p[1] == '\0') {
+      push_literal(*p, hidden);
+      continue;
+    }
+    switch (*++p) {
+      case 'u': push_segment(Segment_User, hidden); break;
+      case 'h': push_segment(Segment_HostShort, hidden); break;
+      case 'H': push_segment(Segment_Host, hidden); break;
+      case 'w': push_segment(Segment_Cwd, hidden); break;
+      case 'W': push_segment(Segment_CwdBase, hidden); break;
+      case 'g':
+        push_segment(Segment_Vcs, hidden);
+        pcache.uses_vcs = true;
+        break;
+      case '$': push_literal(geteuid() == 0 ? '#' : '$', hidden); break;
+      case 'n': push_literal('\n', hidden); break;
+      case 'e': push_literal('\033', hidden); break;
+      case 'a': push_literal('\a', hidden); break;
+      case '\\': push_literal('\\', hidden); break;
+      case '[': hidden = true; break;
+      case ']': hidden = false; break;
+      case '0': case '1': case '2': case '3': case '4': case '5': case '6': case '7': {
+        int value = 0;
+        for (int i = 0; i < 3 && *p >= '0' && *p <= '7'; i++, p++)
+          value = value * 8 + (*p - '0');
+        p--;
+        push_literal((char)value, hidden);
+        break;
+      }
+      default:
+        push_literal('\\', hidden);
+        push_literal(*p, hidden);
+        break;
+    }
+  }
+}
+
+static const char* current_template(void) {
+  Variable* var = variable_table ? get_variable(variable_table, _SLIT("PS1")) : NULL;
+  if (var != NULL && var->value.type == VAR_STRING && var->value._str.str != NULL)
+    return var->value._str.str;
+  const char* env = getenv("PS1");
+  return env != NULL ? env : DEFAULT_PS1;
+}
+
+static void load_identity(void) {
+  long host_name_max = sysconf(_SC_HOST_NAME_MAX);
+  if (host_name_max == -1)
+    host_name_max = _POSIX_HOST_NAME_MAX;
+  char* hostname = rmalloc((size_t)host_name_max + 1);
+  if (gethostname(hostname, (size_t)host_name_max + 1) != 0) {
+    perror("Error getting hostname");
+    rfree(hostname);
+    hostname = NULL;
+  }
+  pcache.host = rstrdup(hostname != NULL ? hostname : "fishydino");
+  rfree(hostname);
+
+  struct passwd *pw = getpwuid(getuid());
+  if (pw == NULL) perror("Failed to get username");
+  pcache.user = rstrdup(pw != NULL ? pw->pw_name : "daniel");
+  pcache.identity_loaded = true;
+}
+
+static void load_cwd(void) {
+  free(pcache.cwd);
+  rfree(pcache.cwd_display);
+  pcache.cwd = getcwd(NULL, 0);
+  if (pcache.cwd == NULL) {
+    perror("Error getting current directory");
+    pcache.cwd_display = rstrdup("~");
+    pcache.cwd_valid = true;
+    return;
+  }
+
+  const char* home = getenv("HOME");
+  size_t home_len = home != NULL ? strlen(home) : 0;
+  if (home_len > 0 && strncmp(pcache.cwd, home, home_len) == 0 && (pcache.cwd[home_len] == '/' || pcache.cwd[home_len] == '\0')) {
+    StringBuilder sb = string_builder__new();
+    string_builder__append_char(&sb, '~');
+    string_builder__append_cstr(&sb, pcache.cwd + home_len);
+    pcache.cwd_display = rstrdup(sb.buffer);
+    string_builder__free(&sb);
+  } else {
+    pcache.cwd_display = rstrdup(pcache.cwd);
+  }
+  pcache.cwd_valid = true;
+}
+
+static size_t visible_width(const char* s, size_t len, size_t width) {
+  for (size_t i = 0; i < len; i++) {
+    unsigned char c = (unsigned char)s[i];
+    if (c == '\n' || c == '\r') {
+      width = 0;
+    } else if (c == '\033' && i + 1 < len && s[i + 1] == '[') {
+      for (i += 2; i < len && !(s[i] >= '@' && s[i] <= '~'); i++);
+    } else if (c >= 0x20 && (c & 0xC0) != 0x80 && c != 0x7f) {
+      width++;
+    }
+  }
+  return width;
+}
+
+static void append_segment(StringBuilder* sb, const char* text, size_t len, bool hidden) {
+  string_builder__append(sb, (string){.str = (char*)text, .len = len, .is_lit = 1});
+  if (!hidden) pcache.width = visible_width(text, len, pcache.width);
+}
+
+string prompt_render(size_t* width) {
+  if (!pcache.template_valid) {
+    const char* ps1 = current_template();
+    if (pcache.source == NULL || strcmp(pcache.source, ps1) != 0) {
+      rfree(pcache.source);
+      pcache.source = rstrdup(ps1);
+      compile_template(ps1);
+    }
+    pcache.template_valid = true;
+  }
+
+  if (!pcache.rendered_valid) {
+    StringBuilder sb = string_builder__new();
+    pcache.width = 0;
+    for (size_t i = 0; i < pcache.count; i++) {
+      const PromptSegment* seg = &pcache.segments[i];
+      const char* value = NULL;
+      switch (seg->kind) {
+        case Segment_Literal:
+          append_segment(&sb, pcache.literals.buffer + seg->start, seg->len, seg->hidden);
+          continue;
+        case Segment_Vcs: {
+          if (!pcache.cwd_valid) load_cwd();
+          size_t start = sb.len;
+          if (git_status_lookup(pcache.cwd, &sb) && !seg->hidden)
+            pcache.width = visible_width(sb.buffer + start, sb.len - start, pcache.width);
+          continue;
+        }
+        case Segment_User:
+        case Segment_Host:
+        case Segment_HostShort:
+          if (!pcache.identity_loaded) load_identity();
+          value = seg->kind == Segment_User ? pcache.user : pcache.host;
+          break;
+        case Segment_Cwd:
+        case Segment_CwdBase:
+          if (!pcache.cwd_valid) load_cwd();
+          value = pcache.cwd_display;
+          break;
+      }
+      size_t len = strlen(value);
+      if (seg->kind == Segment_HostShort) {
+        const char* dot = strchr(value, '.');
+        if (dot != NULL) len = (size_t)(dot - value);
+      } else if (seg->kind == Segment_CwdBase && len > 1) {
+        const char* slash = strrchr(value, '/');
+        if (slash != NULL) {
+          len -= (size_t)(slash + 1 - value);
+          value = slash + 1;
+        }
+      }
+      append_segment(&sb, value, len, seg->hidden);
+    }
+    string__free(pcache.rendered);
+    pcache.rendered = string_builder__to_string(&sb);
+    string_builder__free(&sb);
+    pcache.rendered_valid = true;
+  }
+
+  if (width != NULL) *width = pcache.width;
+  return pcache.rendered;
+}
+
+/* Segments backed by a background worker are drawn from their cached value
+ * and refreshed here; prompt_async_pending() tells the caller to keep
+ * polling so the prompt can be redrawn once the fresh value lands. */
+void prompt_request_async(void) {
+  if (pcache.uses_vcs) git_status_request(prompt_cwd());
+}
+
+int prompt_async_fd(void) {
+  return git_status_event_fd();
+}
+
+bool prompt_async_pending(void) {
+  return pcache.uses_vcs && git_status_pending();
+}
+
+bool prompt_async_changed(void) {
+  if (!pcache.uses_vcs || !git_status_changed()) return false;
+  prompt_invalidate(Prompt_Vcs);
+  return true;
+}
+
+const char* prompt_cwd(void) {
+  if (!pcache.cwd_valid) load_cwd();
+  return pcache.cwd;
+}
+
+void prompt_invalidate(PromptTrigger trigger) {
+  switch (trigger) {
+    case Prompt_Cwd: pcache.cwd_valid = false; break;
+    case Prompt_Template: pcache.template_valid = false; break;
+    case Prompt_Vcs: break;
+  }
+  pcache.rendered_valid = false;
+}
+
+void prompt_free(void) {
+  git_status_free();
+  rfree(pcache.source);
+  string_builder__free(&pcache.literals);
+  rfree(pcache.segments);
+  rfree(pcache.user);
+  rfree(pcache.host);
+  free(pcache.cwd);
+  rfree(pcache.cwd_display);
+  string__free(pcache.rendered);
+  memset(&pcache, 0, sizeof(pcache));
+}
@@ -0,0 +1,186 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include "script.h"
+#include "memory.h"
+
+typedef enum {
+  SCAN_TEXT,
+  SCAN_END,
+  SCAN_JOIN,
+  SCAN_COMMENT,
+} ScanClass;
+
+/* Classifies `c`; SCAN_JOIN is the newline of a `\` continuation. Inside
+ * single quotes a backslash is an ordinary character. */
+static ScanClass scan_step(ScanState* st, char c) {
+  if (st->comment) return c == '\n' ? SCAN_END : SCAN_COMMENT;
+  if (st->escaped) {
+    st->escaped = false;
+    st->word_start = false;
+    return c == '\n' ? SCAN_JOIN : SCAN_TEXT;
+  }
+  if (st->quote != '\0') {
+    if (c == st->quote) st->quote = '\0';
+    else if (c == '\\' && st->quote == '"') st->escaped = true;
+    return SCAN_TEXT;
+  }
+  switch (c) {
+    case '\n':
+      return SCAN_END;
+    case '\\':
+      st->escaped = true;
+      break;
+    case '\'':
+    case '"':
+      st->quote = c;
+      break;
+    case '#':
+      if (st->word_start) {
+        st->comment = true;
+        return SCAN_COMMENT;
+      }
+      break;
+    default:
+      break;
+  }
+  st->word_start = strchr(" \t;|&()", c) != NULL;
+  return SCAN_TEXT;
+}
+
+static bool find_end(ScriptReader* reader, size_t* end) {
+  for (; reader->scanned < reader->len; reader->scanned++) {
+    if (scan_step(&reader->scan, reader->buffer[reader->scanned]) == SCAN_END) {
+      *end = reader->scanned;
+      return true;
+    }
+  }
+  return false;
+}
+
+/* Drops comments and `\`-newline pairs in place. */
+static size_t compact(char* text, size_t len) {
+  ScanState st = {.word_start = true};
+  size_t out = 0;
+  for (size_t at = 0; at < len; at++) {
+    ScanClass cls = scan_step(&st, text[at]);
+    if (cls == SCAN_COMMENT) continue;
+    if (cls == SCAN_JOIN) out--;
+    else text[out++] = text[at];
+  }
+  return out;
+}
+
+/* The unread tail moves to the front, so the buffer only grows when one
+ * statement outgrows it; one byte is kept spare for the terminator. */
+static bool read_more(ScriptReader* reader) {
+  if (reader->eof) return false;
+  if (reader->start > 0) {
+    memmove(reader->buffer, reader->buffer + reader->start, reader->len - reader->start);
+    reader->len -= reader->start;
+    reader->scanned -= reader->start;
+    reader->start = 0;
+  }
+  if (reader->capacity - reader->len <= SCRIPT_READ_CHUNK) {
+    size_t capacity = reader->capacity * 2;
+    if (capacity < reader->len + SCRIPT_READ_CHUNK + 1) capacity = reader->len + SCRIPT_READ_CHUNK + 1;
+    reader->buffer = rrealloc(reader->buffer, capacity);
+    reader->capacity = capacity;
+  }
+  size_t want = reader->capacity - reader->len - 1;
+  if (want > reader->chunk) want = reader->chunk;
+  ssize_t n;
+  do {
+    n = read(reader->fd, reader->buffer + reader->len, want);
+  } while (n == -1 && errno == EINTR);
+  if (n <= 0) {
+    reader->eof = true;
+    return false;
+  }
+  reader->len += (size_t)n;
+  return true;
+}
+
+void script_reader_init_fd(ScriptReader* reader, int fd) {
+  memset(reader, 0, sizeof(*reader));
+  reader->fd = fd;
+  reader->line = 1;
+  reader->scan.word_start = true;
+  reader->chunk = SCRIPT_READ_CHUNK;
+  reader->rewound_to = -1;
+  if (fd == STDIN_FILENO) {
+    if (lseek(fd, 0, SEEK_CUR) == -1) reader->chunk = 1;
+    else reader->rewind = true;
+  }
+}
+
+void script_reader_init_text(ScriptReader* reader, const char* text, size_t len) {
+  memset(reader, 0, sizeof(*reader));
+  reader->fd = -1;
+  reader->buffer = rmalloc(len + 1);
+  memcpy(reader->buffer, text, len);
+  reader->len = len;
+  reader->capacity = len + 1;
+  reader->eof = true;
+  reader->line = 1;
+  reader->scan.word_start = true;
+  reader->chunk = SCRIPT_READ_CHUNK;
+  reader->rewound_to = -1;
+}
+
+/* Undoes rewind_input() if the offset is where it was left; otherwise the
+ * statement read from stdin itself and the buffered tail is stale. */
+static void resume_input(ScriptReader* reader) {
+  if (reader->rewound_to == -1) return;
+  if (lseek(reader->fd, 0, SEEK_CUR) == reader->rewound_to) {
+    lseek(reader->fd, (off_t)(reader->len - reader->start), SEEK_CUR);
+  } else {
+    reader->len = reader->start;
+    reader->scanned = reader->start;
+    reader->eof = false;
+  }
+  reader->rewound_to = -1;
+}
+
+static void rewind_input(ScriptReader* reader) {
+  if (reader->rewind) reader->rewound_to = lseek(reader->fd, -(off_t)(reader->len - reader->start), SEEK_CUR);
+}
+
+bool script_reader_next(ScriptReader* reader, string* statement, size_t* line) {
+  resume_input(reader);
+  for (;;) {
+    size_t end;
+    while (!find_end(reader, &end)) {
+      if (!read_more(reader)) {
+        end = reader->len;
+        break;
+      }
+    }
+    if (reader->start == reader->len) return false;
+
+    char* text = reader->buffer + reader->start;
+    size_t len = end - reader->start;
+    *line = reader->line;
+    for (const char* nl = text; (nl = memchr(nl, '\n', (size_t)(text + len - nl))) != NULL; nl++) reader->line++;
+    reader->line++;
+    reader->start = end < reader->len ? end + 1 : end;
+    reader->scanned = reader->start;
+    reader->scan = (ScanState){.word_start = true};
+
+    len = compact(text, len);
+    text[len] = '\0';
+    size_t lead = strspn(text, " \t\r\n");
+    if (lead == len) continue;
+    *statement = (string){.str = text, .len = len, .is_lit = 1};
+    rewind_input(reader);
+    return true;
+  }
+}
+
+void script_reader_free(ScriptReader* reader) {
+  rfree(reader->buffer);
+  memset(reader, 0, sizeof(*reader));
+}
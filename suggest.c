@@ -0,0 +1,267 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include "suggest.h"
+#include "histstore.h"
+#include "memory.h"
+#include "profile.h"
+
+#define SUGGEST_HALF_LIFE 1000.0
+#define SUGGEST_CWD_WEIGHT 8.0
+#define SUGGEST_SESSION_MAX 1024
+#define SUGGEST_NONE UINT32_MAX
+
+typedef struct {
+  string text;
+  uint32_t count;
+  uint32_t last_seq;
+  double score;
+} SuggestEntry;
+
+/* Built once by the worker from the history file and never modified after it
+ * is published, so lookups need no locking. */
+typedef struct {
+  SuggestEntry* entries;
+  uint32_t size;
+  uint32_t* sorted;
+  uint32_t* tree;
+  size_t leaves;
+  uint32_t* slots;
+  size_t slot_mask;
+  uint32_t base_seq;
+} SuggestIndex;
+
+typedef struct {
+  string text;
+  uint32_t count;
+  uint32_t seq;
+  uint64_t dir;
+} SessionEntry;
+
+static struct {
+  pthread_t worker;
+  bool worker_started;
+  atomic_bool cancel;
+  _Atomic(SuggestIndex*) index;
+  SessionEntry session[SUGGEST_SESSION_MAX];
+  size_t session_size;
+  size_t session_next;
+  uint32_t session_seq;
+  uint64_t dir;
+} suggest;
+
+static uint64_t suggest_hash(const char* s, size_t len) {
+  uint64_t h = 14695981039346656037ULL;
+  for (size_t i = 0; i < len; i++) {
+    h ^= (unsigned char)s[i];
+    h *= 1099511628211ULL;
+  }
+  return h;
+}
+
+/* Frecency: how often a line was run, weighted by how many commands ago it
+ * last ran; the weight halves after SUGGEST_HALF_LIFE commands. */
+static double suggest_score(uint32_t count, uint32_t age) {
+  return (double)count / (1.0 + (double)age / SUGGEST_HALF_LIFE);
+}
+
+static int suggest_compare_text(const string a, const string b) {
+  size_t n = a.len < b.len ? a.len : b.len;
+  int c = memcmp(a.str, b.str, n);
+  if (c != 0) return c;
+  return a.len < b.len ? -1 : a.len > b.len ? 1 : 0;
+}
+
+static SuggestEntry* sort_entries;
+
+static int suggest_sort_cmp(const void* a, const void* b) {
+  return suggest_compare_text(sort_entries[*(const uint32_t*)a].text, sort_entries[*(const uint32_t*)b].text);
+}
+
+static uint32_t suggest_better(const SuggestIndex* idx, uint32_t a, uint32_t b) {
+  if (a == SUGGEST_NONE) return b;
+  if (b == SUGGEST_NONE) return a;
+  return idx->entries[a].score >= idx->entries[b].score ? a : b;
+}
+
+static uint32_t* suggest_index_find(const SuggestIndex* idx, const string text) {
+  size_t i = (size_t)suggest_hash(text.str, text.len) & idx->slot_mask;
+  for (;; i = (i + 1) & idx->slot_mask) {
+    uint32_t id = idx->slots[i];
+    if (id == SUGGEST_NONE || string__equals(idx->entries[id].text, text)) return &idx->slots[i];
+  }
+}
+
+static void suggest_index_free(SuggestIndex* idx) {
+  if (idx == NULL) return;
+  rfree(idx->entries);
+  rfree(idx->sorted);
+  rfree(idx->tree);
+  rfree(idx->slots);
+  rfree(idx);
+}
+
+static SuggestIndex* suggest_build(void) {
+  size_t count = history_store_file_count();
+  SuggestIndex* idx = rcalloc(1, sizeof(SuggestIndex));
+  idx->base_seq = (uint32_t)count;
+
+  size_t slots = 1024;
+  while (slots < count * 2) slots <<= 1;
+  idx->slots = rmalloc(slots * sizeof(uint32_t));
+  memset(idx->slots, 0xff, slots * sizeof(uint32_t));
+  idx->slot_mask = slots - 1;
+  idx->entries = rmalloc((count ? count : 1) * sizeof(SuggestEntry));
+
+  for (size_t i = 0; i < count; i++) {
+    if ((i & 0xffff) == 0 && atomic_load_explicit(&suggest.cancel, memory_order_relaxed)) {
+      suggest_index_free(idx);
+      return NULL;
+    }
+    string text = history_store_get(i);
+    uint32_t* slot = suggest_index_find(idx, text);
+    if (*slot == SUGGEST_NONE) {
+      *slot = idx->size;
+      idx->entries[idx->size++] = (SuggestEntry){.text = text, .count = 0};
+    }
+    SuggestEntry* e = &idx->entries[*slot];
+    e->count++;
+    e->last_seq = (uint32_t)i;
+  }
+
+  idx->sorted = rmalloc((idx->size ? idx->size : 1) * sizeof(uint32_t));
+  for (uint32_t i = 0; i < idx->size; i++) {
+    idx->sorted[i] = i;
+    idx->entries[i].score = suggest_score(idx->entries[i].count, idx->base_seq - 1 - idx->entries[i].last_seq);
+  }
+  sort_entries = idx->entries;
+  qsort(idx->sorted, idx->size, sizeof(uint32_t), suggest_sort_cmp);
+
+  idx->leaves = 1;
+  while (idx->leaves < idx->size) idx->leaves <<= 1;
+  idx->tree = rmalloc(2 * idx->leaves * sizeof(uint32_t));
+  for (size_t i = 0; i < idx->leaves; i++)
+    idx->tree[idx->leaves + i] = i < idx->size ? idx->sorted[i] : SUGGEST_NONE;
+  for (size_t i = idx->leaves; i-- > 1;)
+    idx->tree[i] = suggest_better(idx, idx->tree[2 * i], idx->tree[2 * i + 1]);
+  return idx;
+}
+
+static void* suggest_worker(void* arg) {
+  (void)arg;
+  long long start = startup_clock_ns();
+  SuggestIndex* idx = suggest_build();
+  if (idx != NULL) atomic_store_explicit(&suggest.index, idx, memory_order_release);
+  startup_background_phase("suggest index", start);
+  return NULL;
+}
+
+void suggest_init(void) {
+  atomic_store(&suggest.cancel, false);
+  atomic_store(&suggest.index, NULL);
+  suggest.worker_started = pthread_create(&suggest.worker, NULL, suggest_worker, NULL) == 0;
+}
+
+void suggest_set_directory(const char* cwd) {
+  suggest.dir = cwd ? suggest_hash(cwd, strlen(cwd)) : 0;
+}
+
+void suggest_add(const string line) {
+  if (line.len == 0) return;
+  uint32_t seq = suggest.session_seq++;
+  for (size_t i = 0; i < suggest.session_size; i++) {
+    SessionEntry* e = &suggest.session[i];
+    if (string__equals(e->text, line)) {
+      e->count++;
+      e->seq = seq;
+      e->dir = suggest.dir;
+      return;
+    }
+  }
+
+  uint32_t count = 1;
+  SuggestIndex* idx = atomic_load_explicit(&suggest.index, memory_order_acquire);
+  if (idx != NULL && idx->size > 0) {
+    uint32_t id = *suggest_index_find(idx, line);
+    if (id != SUGGEST_NONE) count += idx->entries[id].count;
+  }
+
+  SessionEntry* e = &suggest.session[suggest.session_next];
+  suggest.session_next = (suggest.session_next + 1) % SUGGEST_SESSION_MAX;
+  if (suggest.session_size < SUGGEST_SESSION_MAX) suggest.session_size++;
+  *e = (SessionEntry){.text = line, .count = count, .seq = seq, .dir = suggest.dir};
+}
+
+static bool suggest_has_prefix(const string text, const string prefix) {
+  return text.len > prefix.len && memcmp(text.str, prefix.str, prefix.len) == 0;
+}
+
+/* Binary search narrows the sorted index to the prefix range, and the max
+ * tree picks its best entry in O(log n); only the bounded session table is
+ * scanned. The tree is ranked by age at build time, and its pick is rescored
+ * with the commands run since then before it competes with the session. */
+string suggest_lookup(const string prefix) {
+  if (prefix.len == 0) return _SLIT0;
+  string best = _SLIT0;
+  double best_score = -INFINITY;
+
+  SuggestIndex* idx = atomic_load_explicit(&suggest.index, memory_order_acquire);
+  if (idx != NULL && idx->size > 0) {
+    size_t lo = 0, hi = idx->size;
+    while (lo < hi) {
+      size_t mid = lo + (hi - lo) / 2;
+      if (suggest_compare_text(idx->entries[idx->sorted[mid]].text, prefix) < 0) lo = mid + 1;
+      else hi = mid;
+    }
+    size_t first = lo;
+    hi = idx->size;
+    while (lo < hi) {
+      size_t mid = lo + (hi - lo) / 2;
+      string text = idx->entries[idx->sorted[mid]].text;
+      if (text.len >= prefix.len && memcmp(text.str, prefix.str, prefix.len) == 0) lo = mid + 1;
+      else hi = mid;
+    }
+    size_t last = lo;
+    if (first < last && idx->entries[idx->sorted[first]].text.len == prefix.len) first++;
+
+    uint32_t found = SUGGEST_NONE;
+    for (size_t l = first + idx->leaves, r = last + idx->leaves; l < r; l >>= 1, r >>= 1) {
+      if (l & 1) found = suggest_better(idx, found, idx->tree[l++]);
+      if (r & 1) found = suggest_better(idx, found, idx->tree[--r]);
+    }
+    if (found != SUGGEST_NONE && suggest_has_prefix(idx->entries[found].text, prefix)) {
+      best = idx->entries[found].text;
+      const SuggestEntry* e = &idx->entries[found];
+      best_score = suggest_score(e->count, idx->base_seq - 1 - e->last_seq + suggest.session_seq);
+    }
+  }
+
+  for (size_t i = 0; i < suggest.session_size; i++) {
+    const SessionEntry* e = &suggest.session[i];
+    if (!suggest_has_prefix(e->text, prefix)) continue;
+    double score = suggest_score(e->count, suggest.session_seq - 1 - e->seq);
+    if (e->dir != 0 && e->dir == suggest.dir) score *= SUGGEST_CWD_WEIGHT;
+    if (score > best_score) {
+      best = e->text;
+      best_score = score;
+    }
+  }
+  return best;
+}
+
+void suggest_free(void) {
+  if (suggest.worker_started) {
+    atomic_store(&suggest.cancel, true);
+    pthread_join(suggest.worker, NULL);
+    suggest.worker_started = false;
+  }
+  suggest_index_free(atomic_exchange(&suggest.index, NULL));
+  suggest.session_size = 0;
+  suggest.session_next = 0;
+}
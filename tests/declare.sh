@@ -0,0 +1,56 @@
+#!/bin/sh
+# Checks that `declare -p` output reads back into the same variables:
+# each case is run, its dump is fed to a fresh shell, and that shell's
+# dump must match the first one byte for byte.
+#
+# Usage: tests/declare.sh   (from anywhere; builds the shell it runs)
+set -eu
+
+ROOT=$(cd "$(dirname "$0")/.." && pwd)
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT INT TERM
+
+make -C "$ROOT" build >/dev/null
+SHELL_BIN="$ROOT/rickshell"
+failed=0
+total=0
+
+dump() {
+  (cat "$1"; echo 'declare -p') > "$WORK/script"
+  env -i HOME="$WORK" "$SHELL_BIN" "$WORK/script" 2>&1 | grep '^declare ' || true
+}
+
+check() {
+  total=$((total + 1))
+  printf '%s\n' "$2" > "$WORK/case"
+  dump "$WORK/case" > "$WORK/first"
+  dump "$WORK/first" > "$WORK/second"
+  if [ ! -s "$WORK/first" ]; then
+    echo "FAIL $1: nothing was dumped"
+    failed=$((failed + 1))
+  elif cmp -s "$WORK/first" "$WORK/second"; then
+    echo "ok   $1"
+  else
+    echo "FAIL $1: dump changed on read-back"
+    diff "$WORK/first" "$WORK/second" | sed 's/^/     /'
+    failed=$((failed + 1))
+  fi
+}
+
+check "plain string" 'a="plain"'
+check "spaces" 'a="a  b c"'
+check "backslash" 'a="x\\y"'
+check "trailing backslash" 'a="x\\"'
+check "dollar" 'a="cost \$5"'
+check "backslash before dollar" 'a="\\\$HOME"'
+check "backtick" 'a="a`b`c"'
+check "integer" 'declare -i n=42'
+check "indexed array" 'declare -a arr=("p q" "r\\s" "t\$u" 7)'
+check "assoc, bare keys" 'declare -A m={[k]="v" [j]=3}'
+check "assoc, quoted keys" 'declare -A m={["sp ace"]="v\\w" ["d\$x"]="z"}'
+check "several variables" 'a="1"
+b="two words"
+declare -a c=("x")'
+
+echo "$((total - failed))/$total passed"
+[ "$failed" -eq 0 ]
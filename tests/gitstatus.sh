@@ -0,0 +1,88 @@
+#!/bin/sh
+# Checks the prompt's git segment against `git status` on throwaway
+# repositories. The segment is " (branch)", with "*" when a tracked file
+# differs from the index; staged-only changes and untracked files are not
+# reported, so neither is counted here.
+#
+# Usage: tests/gitstatus.sh   (from anywhere; builds the objects it needs)
+set -eu
+
+ROOT=$(cd "$(dirname "$0")/.." && pwd)
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT INT TERM
+
+make -C "$ROOT" build >/dev/null
+OBJS=$(ls "$ROOT"/*.o | grep -v '/main\.o$')
+DRV="$WORK/gitstatus_drv"
+if ! gcc -I"$ROOT/include" -O2 -o "$DRV" "$ROOT/tests/gitstatus_drv.c" $OBJS \
+    "$ROOT/target/lib/libbuiltin.a" "$ROOT/target/lib/libreadline.a" \
+    -lncurses -ltinfo -ldl -lm -lpthread 2>"$WORK/link.log"; then
+  cat "$WORK/link.log" >&2
+  exit 1
+fi
+
+GIT="git -c user.email=test@example.com -c user.name=test -c init.defaultBranch=main"
+failed=0
+total=0
+
+expected() {
+  if ! git rev-parse --is-inside-work-tree >/dev/null 2>&1; then
+    echo "(none)"
+    return
+  fi
+  branch=$(git symbolic-ref --short -q HEAD || git rev-parse --short=7 HEAD)
+  dirty=$(git status --porcelain --untracked-files=no | cut -c2 | tr -d ' \n')
+  if [ -n "$dirty" ]; then echo " ($branch*)"; else echo " ($branch)"; fi
+}
+
+check() {
+  total=$((total + 1))
+  want=$(expected)
+  got=$("$DRV" "$PWD")
+  if [ "$got" = "$want" ]; then
+    echo "ok   $1"
+  else
+    echo "FAIL $1: got '$got', git says '$want'"
+    failed=$((failed + 1))
+  fi
+}
+
+cd "$WORK"
+mkdir repo && cd repo
+$GIT init -q
+echo a > a && mkdir sub && echo b > sub/b && ln -s a link
+$GIT add . && $GIT commit -qm init
+check "clean"
+
+echo x >> a; check "modified, size changed"
+git checkout -q a; check "restored"
+touch a; check "touched only"
+sleep 1; printf 'A\n' > a; check "same-size edit"
+git checkout -q a
+chmod +x sub/b; check "mode change"
+chmod -x sub/b
+rm link; check "deleted symlink"
+git checkout -q link
+echo new > c; check "untracked file"
+rm c
+echo s > a; $GIT add a; check "staged only"
+git reset -q --hard
+cd sub; check "from a subdirectory"; cd ..
+git checkout -q --detach; check "detached HEAD"
+git checkout -q main
+git update-index --index-version 4
+echo y >> sub/b; check "index v4, dirty"
+git checkout -q sub/b; check "index v4, clean"
+$GIT worktree add -q ../wt -b other
+cd ../wt; check "linked worktree"
+cd "$WORK"; check "outside a repository"
+cd repo
+
+i=0
+while [ $i -lt 3000 ]; do echo $i > f$i; i=$((i + 1)); done
+$GIT add . && $GIT commit -qm many
+check "3000 files, clean"
+echo z >> f1500; check "3000 files, one dirty"
+
+echo "$((total - failed))/$total passed"
+[ $failed -eq 0 ]
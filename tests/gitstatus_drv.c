@@ -0,0 +1,28 @@
+#include <stdio.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <signal.h>
+#include "gitstatus.h"
+
+/* Normally defined in main.c, which is not linked into this driver. */
+volatile sig_atomic_t keep_running = 1;
+volatile int last_status = 0;
+bool interactive = false;
+
+/* Prints the prompt's git segment for each directory argument, waiting for
+ * the worker instead of drawing whatever is cached. */
+int main(int argc, char** argv) {
+  for (int i = 1; i < argc; i++) {
+    git_status_request(argv[i]);
+    while (git_status_pending()) {
+      git_status_changed();
+      usleep(1000);
+    }
+    StringBuilder sb = string_builder__new();
+    if (git_status_lookup(argv[i], &sb)) printf("%s\n", sb.buffer);
+    else printf("(none)\n");
+    string_builder__free(&sb);
+  }
+  git_status_free();
+  return 0;
+}
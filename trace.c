@@ -0,0 +1,117 @@
+#define _GNU_SOURCE
+#include "trace.h"
+#if defined(_HYUNSEO_DEV_TRACE_SPANS)
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <pthread.h>
+#include "io.h"
+#include "memory.h"
+
+#define TRACE_BUFFER_EVENTS 4096
+#define TRACE_EVENT_JSON_MAX 160
+
+typedef struct {
+  const char* name;
+  uint64_t start_ns;
+  uint64_t end_ns;
+  bool instant;
+} TraceEvent;
+
+static struct {
+  int fd;
+  pid_t pid;
+  size_t count;
+  TraceEvent events[TRACE_BUFFER_EVENTS];
+} trace_ctx = { .fd = -1 };
+
+uint64_t trace_now(void) {
+  if (trace_ctx.fd == -1) return 0;
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static void trace_atfork_child(void) {
+  trace_ctx.pid = getpid();
+  trace_ctx.count = 0;
+}
+
+void trace_init(void) {
+  const char* path = getenv("RICKSHELL_TRACE");
+  if (path == NULL || *path == '\0') return;
+
+  int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC, 0644);
+  if (fd == -1) {
+    ffprintln(stderr, "trace: cannot open %s", path);
+    return;
+  }
+  trace_ctx.fd = fd;
+  trace_ctx.pid = getpid();
+  trace_ctx.count = 0;
+  _write(fd, "[\n", 2);
+  pthread_atfork(NULL, NULL, trace_atfork_child);
+}
+
+static void trace_push(const char* name, uint64_t start_ns, uint64_t end_ns, bool instant) {
+  if (trace_ctx.fd == -1) return;
+  if (trace_ctx.count == TRACE_BUFFER_EVENTS) trace_flush();
+  TraceEvent* ev = &trace_ctx.events[trace_ctx.count++];
+  ev->name = name;
+  ev->start_ns = start_ns;
+  ev->end_ns = end_ns;
+  ev->instant = instant;
+}
+
+void trace_span(const char* name, uint64_t start_ns, uint64_t end_ns) {
+  trace_push(name, start_ns, end_ns, false);
+}
+
+void trace_instant(const char* name) {
+  uint64_t now = trace_now();
+  trace_push(name, now, now, true);
+}
+
+/* Chrome's JSON array format tolerates a missing closing bracket, which lets
+ * every process (including children about to exec) append independently. */
+void trace_flush(void) {
+  if (trace_ctx.fd == -1 || trace_ctx.count == 0) return;
+
+  size_t cap = trace_ctx.count * TRACE_EVENT_JSON_MAX;
+  char* buf = rmalloc(cap);
+
+  size_t len = 0;
+  for (size_t i = 0; i < trace_ctx.count; i++) {
+    const TraceEvent* ev = &trace_ctx.events[i];
+    double ts = (double)ev->start_ns / 1000.0;
+    int n;
+    if (ev->instant) {
+      n = snprintf(buf + len, cap - len,
+        "{\"name\":\"%s\",\"ph\":\"i\",\"s\":\"p\",\"ts\":%.3f,\"pid\":%d,\"tid\":%d},\n",
+        ev->name, ts, (int)trace_ctx.pid, (int)trace_ctx.pid);
+    } else {
+      double dur = (double)(ev->end_ns - ev->start_ns) / 1000.0;
+      n = snprintf(buf + len, cap - len,
+        "{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%d,\"tid\":%d},\n",
+        ev->name, ts, dur, (int)trace_ctx.pid, (int)trace_ctx.pid);
+    }
+    if (n < 0 || (size_t)n >= cap - len) break;
+    len += (size_t)n;
+  }
+
+  _write(trace_ctx.fd, buf, len);
+  rfree(buf);
+  trace_ctx.count = 0;
+}
+
+void trace_shutdown(void) {
+  if (trace_ctx.fd == -1) return;
+  trace_flush();
+  close(trace_ctx.fd);
+  trace_ctx.fd = -1;
+}
+#endif
@@ -2,6 +2,8 @@
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <fcntl.h>
+#include <unistd.h>
 #include "variable.h"
 #include "memory.h"
 #include "io.h"
@@ -12,6 +14,7 @@
 #include "rstring.h"
 #include "map.h"
 #include "iterator.h"
+#include "prompt.h"
 
 #define INITIAL_TABLE_SIZE 10
 
@@ -96,6 +99,11 @@ void process_exported_variable(Variable* var) {
   }
 }
 
+static void notify_prompt(const string name) {
+  if (string__equals(name, _SLIT("PS1"))) prompt_invalidate(Prompt_Template);
+  else if (string__equals(name, _SLIT("HOME"))) prompt_invalidate(Prompt_Cwd);
+}
+
 Variable* set_variable(VariableTable* table, const string name, const string value, VariableType type, bool readonly) {
   Variable* var = get_variable(table, name);
   if (var == NULL) {
@@ -139,6 +147,7 @@ Variable* set_variable(VariableTable* table, const string name, const string val
   }
   if (readonly) set_variable_flag(&var->flags, VarFlag_ReadOnly);
   process_exported_variable(var);
+  notify_prompt(name);
   return var;
 }
 
@@ -174,6 +183,7 @@ void unset_variable(VariableTable* table, const string name) {
       free_va_value(&table->variables[i].value);
       memmove(&table->variables[i], &table->variables[i + 1], (size_t)((table->size - i - 1) * (int)sizeof(Variable)));
       table->size--;
+      notify_prompt(name);
       return;
     }
   }
@@ -428,22 +438,33 @@ static ssize_t identify_value_string_end(const string str) {
   return -1;
 }
 
-static ssize_t find_key_value_terminator(const string str) {
-  if (str.str[0] != '[') return -1;
-  ssize_t keyend = 0;
+/* Keys are either bare ([name]=) or double-quoted (["a b"]=); *keyend is
+ * set to the index of the closing ']'. */
+static ssize_t find_key_value_terminator(const string str, ssize_t* keyend) {
+  if (str.len < 2 || str.str[0] != '[') return -1;
+  ssize_t end = 0;
   register size_t i;
-  for (i = 1; i < str.len; i++) {
-    if (!isalnum(str.str[i]) && str.str[i] != '_') {
-      keyend = (ssize_t)i;
-      break;
+  if (str.str[1] == '"') {
+    string temp = string__substring(str, 2);
+    ssize_t index = string__indexof(temp, _SLIT("\""));
+    string__free(temp);
+    if (index == -1) return -1;
+    end = index + 3;
+  } else {
+    for (i = 1; i < str.len; i++) {
+      if (!isalnum(str.str[i]) && str.str[i] != '_') {
+        end = (ssize_t)i;
+        break;
+      }
     }
   }
-  if (str.str[keyend] != ']' || str.str[keyend + 1] != '=') return -1;
-  string temp = string__substring(str, keyend + 2);
+  if (end == 0 || end + 1 >= (ssize_t)str.len || str.str[end] != ']' || str.str[end + 1] != '=') return -1;
+  string temp = string__substring(str, end + 2);
   ssize_t value_end = identify_value_string_end(temp);
   string__free(temp);
   if (value_end == -1) return -1;
-  return keyend + 3 + value_end;
+  *keyend = end;
+  return end + 2 + value_end;
 }
 
 va_value_t string_to_va_value(const string str, VariableType type) {
@@ -503,14 +524,20 @@ va_value_t string_to_va_value(const string str, VariableType type) {
       string trimmed = string__substring(str, 1, (ssize_t)str.len - 1);
       string input = string__trim(trimmed);
       while (input.len > 0) {
-        ssize_t last_index = find_key_value_terminator(input);
+        ssize_t keyend;
+        ssize_t last_index = find_key_value_terminator(input, &keyend);
         if (last_index == -1) {
           print_error(_SLIT("Invalid key-value pair format"));
           map_free(result._map);
+          result._map = create_map_with_func(vfree_va_value);
           break;
         }
-        ssize_t keyend = string__indexof(input, _SLIT("]"));
-        string key = string__substring(input, 1, keyend);
+        string key;
+        {
+          string temp = string__substring(input, 1, keyend);
+          key = string__remove_quotes(temp);
+          string__free(temp);
+        }
         string value = string__substring(input, keyend + 2, last_index);
         {
           string temp = string__trim(value);
@@ -587,6 +614,13 @@ string expand_variables(VariableTable* table, const string input) {
   ssize_t p = 0;
 
   while (p < (ssize_t)input.len) {
+    /* \$, \\ and \" stand for the character itself; this is how the
+     * declare -p dump quotes values. */
+    if (input.str[p] == '\\' && p + 1 < (ssize_t)input.len && strchr("$\\\"", input.str[p + 1])) {
+      string_builder__append_char(&sb, input.str[p + 1]);
+      p += 2;
+      continue;
+    }
     if (input.str[p] == '$') {
       if (p + 1 < (ssize_t)input.len && input.str[p + 1] == '{') {
         ssize_t end;
@@ -1054,6 +1088,131 @@ string expand_variables(VariableTable* table, const string input) {
   return result;
 }
 
+static void dump_quoted(StringBuilder* sb, const string s) {
+  size_t run_start = 0;
+  string_builder__append_char(sb, '"');
+  for (size_t i = 0; i < s.len; i++) {
+    char c = s.str[i];
+    if (c != '"' && c != '\\' && c != '$') continue;
+    string_builder__append(sb, (string){s.str + run_start, i - run_start, 1});
+    string_builder__append(sb, (string){(char[]){'\\', c}, 2, 1});
+    run_start = i + 1;
+  }
+  string_builder__append(sb, (string){s.str + run_start, s.len - run_start, 1});
+  string_builder__append_char(sb, '"');
+}
+
+static void dump_key(StringBuilder* sb, const string key) {
+  bool bare = key.len > 0;
+  for (size_t i = 0; i < key.len && bare; i++)
+    bare = isalnum((unsigned char)key.str[i]) || key.str[i] == '_';
+  if (bare) string_builder__append(sb, key);
+  else dump_quoted(sb, key);
+}
+
+static void dump_va_value(StringBuilder* sb, const va_value_t* value) {
+  switch (value->type) {
+    case VAR_INTEGER:
+      string_builder__append_long_long(sb, value->_number);
+      break;
+    case VAR_ARRAY: {
+      string_builder__append_char(sb, '(');
+      for (size_t i = 0; i < value->_array.size; i++) {
+        if (i > 0) string_builder__append_char(sb, ' ');
+        dump_va_value(sb, array_checked_get(value->_array, i));
+      }
+      string_builder__append_char(sb, ')');
+      break;
+    }
+    case VAR_ASSOCIATIVE_ARRAY: {
+      string_builder__append_char(sb, '{');
+      if (value->_map != NULL) {
+        MapIterator it = map_iterator(value->_map);
+        bool first = true;
+        while (map_has_next(&it)) {
+          const char* key = map_next(&it);
+          const va_value_t* element = map_iterator_get_value(&it, NULL);
+          if (!first) string_builder__append_char(sb, ' ');
+          string_builder__append_char(sb, '[');
+          dump_key(sb, (string){(char*)key, strlen(key), 1});
+          string_builder__append(sb, _SLIT("]="));
+          dump_va_value(sb, element);
+          first = false;
+        }
+      }
+      string_builder__append_char(sb, '}');
+      break;
+    }
+    case VAR_STRING:
+    case VAR_NAMEREF:
+    default:
+      dump_quoted(sb, value->_str);
+      break;
+  }
+}
+
+void dump_variable(StringBuilder* sb, const Variable* var, VarDumpStyle style) {
+  if (style == VarDump_Declare) {
+    char flags[8];
+    size_t n = 0;
+    switch (var->value.type) {
+      case VAR_INTEGER: flags[n++] = 'i'; break;
+      case VAR_ARRAY: flags[n++] = 'a'; break;
+      case VAR_ASSOCIATIVE_ARRAY: flags[n++] = 'A'; break;
+      case VAR_NAMEREF: flags[n++] = 'n'; break;
+      default: break;
+    }
+    if (var->flags & VarFlag_ReadOnly) flags[n++] = 'r';
+    if (var->flags & VarFlag_Exported) flags[n++] = 'x';
+    if (var->flags & VarFlag_Uppercase) flags[n++] = 'u';
+    if (var->flags & VarFlag_Lowercase) flags[n++] = 'l';
+    if (n == 0) flags[n++] = '-';
+
+    string_builder__append(sb, _SLIT("declare -"));
+    string_builder__append(sb, (string){flags, n, 1});
+    string_builder__append_char(sb, ' ');
+  }
+  string_builder__append(sb, var->name);
+  string_builder__append_char(sb, '=');
+  dump_va_value(sb, &var->value);
+  string_builder__append_char(sb, '\n');
+}
+
+bool dump_variables(VariableTable* table, va_flag_t filter, VarDumpStyle style, int fd) {
+  if (table == NULL) return false;
+  StringBuilder sb = string_builder__with_capacity((size_t)table->size * 32 + 1);
+  for (int i = 0; i < table->size; i++) {
+    const Variable* var = &table->variables[i];
+    if (filter != 0 && (var->flags & filter) != filter) continue;
+    dump_variable(&sb, var, style);
+  }
+
+  if (fd == STDOUT_FILENO) fflush(stdout);
+  bool ok = _write(fd, sb.buffer, sb.len) == (ssize_t)sb.len;
+  string_builder__free(&sb);
+  return ok;
+}
+
+bool save_variables(VariableTable* table, const char* path) {
+  if (table == NULL || path == NULL) return false;
+  size_t tmp_len = strlen(path) + 5;
+  char* tmp_path = rmalloc(tmp_len);
+  snprintf(tmp_path, tmp_len, "%s.tmp", path);
+
+  int fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+  if (fd == -1) {
+    rfree(tmp_path);
+    return false;
+  }
+
+  bool ok = dump_variables(table, 0, VarDump_Declare, fd);
+  if (close(fd) != 0) ok = false;
+  if (ok && rename(tmp_path, path) != 0) ok = false;
+  if (!ok) unlink(tmp_path);
+  rfree(tmp_path);
+  return ok;
+}
+
 bool is_variable_any_flag_set(va_flag_t* vf) { return *vf != 0; }
 bool is_variable_flag_set(va_flag_t* vf, va_flag_t flag) { return (*vf & flag) != 0; }
 void set_variable_flag(va_flag_t* vf, va_flag_t flag) { *vf |= flag; }